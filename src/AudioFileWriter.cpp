@@ -0,0 +1,116 @@
+#include <chrono>
+#include "AudioFileWriter.h"
+#include "Exceptions.h"
+
+/**
+ * @param ringBuffer - Read from by the writer thread only, until the writer is deleted
+ */
+AudioFileWriter::AudioFileWriter(const std::string &fileName, AudioRingBuffer *ringBuffer, int sampleRate) {
+    file = fopen(fileName.c_str(), "wb");
+
+    if (file == nullptr) {
+        throw IOException(Utils::implodeString({"Unable to open audio file '", fileName, "' for writing"}));
+    }
+
+    wav = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".wav") == 0;
+    this->sampleRate = sampleRate;
+    this->ringBuffer = ringBuffer;
+    stopping = false;
+    framesWritten = 0;
+
+    if (wav) {
+        writeWAVHeader();
+    }
+
+    thread = std::thread(&AudioFileWriter::run, this);
+}
+
+/**
+ * Writes out whatever is left in the ring buffer and closes the file
+ */
+AudioFileWriter::~AudioFileWriter() {
+    stopping = true;
+    thread.join();
+    fclose(file);
+}
+
+uint64_t AudioFileWriter::getFramesWritten() {
+    return framesWritten;
+}
+
+void AudioFileWriter::run() {
+    while (true) {
+        // Checked before draining, so nothing written before stopping is missed
+        bool stop = stopping;
+
+        if (!drain()) {
+            if (stop) {
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_WRITER_POLL_MILLISECONDS));
+        }
+    }
+}
+
+/**
+ * @return Whether anything was written
+ */
+bool AudioFileWriter::drain() {
+    bool written = false;
+    const int16_t *samples;
+    size_t frames;
+
+    while ((frames = ringBuffer->getReadRegion(samples)) > 0) {
+        fwrite(samples, sizeof(int16_t) * AUDIO_CHANNELS, frames, file);
+        ringBuffer->consume(frames);
+        framesWritten += frames;
+        written = true;
+    }
+
+    if (written && wav) {
+        writeWAVHeader();
+    }
+
+    return written;
+}
+
+/**
+ * Writes (or rewrites) the 44 byte header at the start of the file with the amount of data written so far
+ */
+void AudioFileWriter::writeWAVHeader() {
+    uint32_t dataBytes = (uint32_t)(framesWritten * AUDIO_CHANNELS * sizeof(int16_t));
+    uint32_t byteRate = sampleRate * AUDIO_CHANNELS * sizeof(int16_t);
+    unsigned char header[44];
+    size_t length = 0;
+
+    auto put = [&header, &length](uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            header[length++] = (value >> (i * 8)) & 0xFF;
+        }
+    };
+
+    auto putTag = [&header, &length](const char *tag) {
+        for (int i = 0; i < 4; i++) {
+            header[length++] = tag[i];
+        }
+    };
+
+    putTag("RIFF");
+    put(36 + dataBytes, 4);
+    putTag("WAVE");
+    putTag("fmt ");
+    put(16, 4);
+    put(1, 2); // PCM
+    put(AUDIO_CHANNELS, 2);
+    put(sampleRate, 4);
+    put(byteRate, 4);
+    put(AUDIO_CHANNELS * sizeof(int16_t), 2);
+    put(16, 2);
+    putTag("data");
+    put(dataBytes, 4);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+    fseek(file, 0, SEEK_END);
+}
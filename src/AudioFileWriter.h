@@ -0,0 +1,46 @@
+#ifndef MEGANOSTALGIA_AUDIOFILEWRITER_H
+#define MEGANOSTALGIA_AUDIOFILEWRITER_H
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "AudioRingBuffer.h"
+
+// How long the writer sleeps when there is nothing to write
+#define AUDIO_WRITER_POLL_MILLISECONDS 10
+
+/**
+ * Streams audio from a ring buffer to a file on its own thread, so capturing audio never holds up emulation. Frames
+ * are written straight out of the ring buffer's memory.
+ *
+ * File names ending in .wav get a 16 bit stereo WAV file, with the header kept up to date after every write so the
+ * file is still usable if the emulator is stopped part way. Anything else gets just the raw samples.
+ */
+class AudioFileWriter {
+public:
+
+    AudioFileWriter(const std::string &fileName, AudioRingBuffer *ringBuffer, int sampleRate);
+
+    ~AudioFileWriter();
+
+    uint64_t getFramesWritten();
+
+private:
+
+    FILE *file;
+    bool wav;
+    int sampleRate;
+    AudioRingBuffer *ringBuffer;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> framesWritten;
+
+    void run();
+
+    bool drain();
+
+    void writeWAVHeader();
+};
+
+#endif //MEGANOSTALGIA_AUDIOFILEWRITER_H
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+#include "AudioResampler.h"
+#include "Scheduler.h"
+#include "YM2612.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_RESAMPLER_SSE2
+#endif
+
+// AVX2 is chosen at runtime so the default build still runs on CPUs without it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AUDIO_RESAMPLER_AVX2
+
+static bool detectAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool avx2Supported = detectAVX2();
+#endif
+
+// Cutoff of the filter as a fraction of the lower of the input and output rates, a little under half
+#define AUDIO_RESAMPLER_CUTOFF 0.45
+
+static inline int16_t scaleOutput(int32_t total) {
+    int32_t value = (total + (1 << (AUDIO_RESAMPLER_COEFFICIENT_BITS - 1))) >> AUDIO_RESAMPLER_COEFFICIENT_BITS;
+    return (int16_t)std::clamp(value, -32768, 32767);
+}
+
+/**
+ * One output sample at a time, the reference implementation
+ *
+ * @return Number of stereo samples written to the output
+ */
+static size_t resampleScalar(const int16_t *left, const int16_t *right, size_t length, uint64_t &position, uint64_t step,
+                             const int16_t *coefficients, int16_t *output) {
+    size_t produced = 0;
+
+    while ((position >> 32) + AUDIO_RESAMPLER_TAPS <= length) {
+        size_t index = position >> 32;
+        const int16_t *phase = coefficients + ((uint32_t)position >> (32 - AUDIO_RESAMPLER_PHASE_BITS)) * AUDIO_RESAMPLER_TAPS;
+        int32_t leftTotal = 0;
+        int32_t rightTotal = 0;
+
+        for (int tap = 0; tap < AUDIO_RESAMPLER_TAPS; tap++) {
+            leftTotal += left[index + tap] * phase[tap];
+            rightTotal += right[index + tap] * phase[tap];
+        }
+
+        output[produced * 2] = scaleOutput(leftTotal);
+        output[produced * 2 + 1] = scaleOutput(rightTotal);
+        produced++;
+        position += step;
+    }
+
+    return produced;
+}
+
+#ifdef AUDIO_RESAMPLER_SSE2
+/**
+ * 8 taps of each side per multiply-add
+ */
+static size_t resampleSSE2(const int16_t *left, const int16_t *right, size_t length, uint64_t &position, uint64_t step,
+                           const int16_t *coefficients, int16_t *output) {
+    size_t produced = 0;
+
+    while ((position >> 32) + AUDIO_RESAMPLER_TAPS <= length) {
+        size_t index = position >> 32;
+        const int16_t *phase = coefficients + ((uint32_t)position >> (32 - AUDIO_RESAMPLER_PHASE_BITS)) * AUDIO_RESAMPLER_TAPS;
+        __m128i leftTotal = _mm_setzero_si128();
+        __m128i rightTotal = _mm_setzero_si128();
+
+        for (int tap = 0; tap < AUDIO_RESAMPLER_TAPS; tap += 8) {
+            __m128i coefficient = _mm_loadu_si128((const __m128i *)(phase + tap));
+            leftTotal = _mm_add_epi32(leftTotal, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(left + index + tap)), coefficient));
+            rightTotal = _mm_add_epi32(rightTotal, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(right + index + tap)), coefficient));
+        }
+
+        // Left in the low half, right in the high half, then add neighbours
+        __m128i totals = _mm_add_epi32(_mm_unpacklo_epi64(leftTotal, rightTotal), _mm_unpackhi_epi64(leftTotal, rightTotal));
+        totals = _mm_add_epi32(totals, _mm_srli_epi64(totals, 32));
+
+        output[produced * 2] = scaleOutput(_mm_cvtsi128_si32(totals));
+        output[produced * 2 + 1] = scaleOutput(_mm_cvtsi128_si32(_mm_unpackhi_epi64(totals, totals)));
+        produced++;
+        position += step;
+    }
+
+    return produced;
+}
+#endif
+
+#ifdef AUDIO_RESAMPLER_AVX2
+/**
+ * 16 taps of each side per multiply-add
+ */
+__attribute__((target("avx2")))
+static size_t resampleAVX2(const int16_t *left, const int16_t *right, size_t length, uint64_t &position, uint64_t step,
+                           const int16_t *coefficients, int16_t *output) {
+    size_t produced = 0;
+
+    while ((position >> 32) + AUDIO_RESAMPLER_TAPS <= length) {
+        size_t index = position >> 32;
+        const int16_t *phase = coefficients + ((uint32_t)position >> (32 - AUDIO_RESAMPLER_PHASE_BITS)) * AUDIO_RESAMPLER_TAPS;
+        __m256i leftTotal = _mm256_setzero_si256();
+        __m256i rightTotal = _mm256_setzero_si256();
+
+        for (int tap = 0; tap < AUDIO_RESAMPLER_TAPS; tap += 16) {
+            __m256i coefficient = _mm256_loadu_si256((const __m256i *)(phase + tap));
+            leftTotal = _mm256_add_epi32(leftTotal, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(left + index + tap)), coefficient));
+            rightTotal = _mm256_add_epi32(rightTotal, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(right + index + tap)), coefficient));
+        }
+
+        // Left in the low 128 bits of each lane, right in the high, then down to 4 values and add neighbours
+        __m256i totals = _mm256_add_epi32(_mm256_unpacklo_epi64(leftTotal, rightTotal), _mm256_unpackhi_epi64(leftTotal, rightTotal));
+        __m128i lanes = _mm_add_epi32(_mm256_castsi256_si128(totals), _mm256_extracti128_si256(totals, 1));
+        lanes = _mm_add_epi32(lanes, _mm_srli_epi64(lanes, 32));
+
+        output[produced * 2] = scaleOutput(_mm_cvtsi128_si32(lanes));
+        output[produced * 2 + 1] = scaleOutput(_mm_cvtsi128_si32(_mm_unpackhi_epi64(lanes, lanes)));
+        produced++;
+        position += step;
+    }
+
+    return produced;
+}
+#endif
+
+/**
+ * @param outputRate - In Hz, usually 44100 or 48000
+ */
+AudioResampler::AudioResampler(int outputRate) {
+    this->outputRate = outputRate;
+    double inputRate = (double)MASTER_CLOCK_RATE / YM2612_MASTER_CYCLES_PER_SAMPLE;
+    baseStep = (uint64_t)llround(inputRate / outputRate * 4294967296.0);
+    vectorised = true;
+    buildFilter();
+    reset();
+}
+
+void AudioResampler::reset() {
+    step = baseStep;
+    position = 0;
+    history[0].clear();
+    history[1].clear();
+}
+
+int AudioResampler::getOutputRate() {
+    return outputRate;
+}
+
+/**
+ * Nudges the output rate to keep the amount of buffered audio steady. Only the step changes, so it can be called every
+ * frame without any clicks.
+ *
+ * @param adjustment - Positive makes more output samples from the same input, up to AUDIO_RESAMPLER_MAX_ADJUSTMENT
+ *                     either way
+ */
+void AudioResampler::setRateAdjustment(double adjustment) {
+    adjustment = std::clamp(adjustment, -AUDIO_RESAMPLER_MAX_ADJUSTMENT, AUDIO_RESAMPLER_MAX_ADJUSTMENT);
+    step = (uint64_t)llround(baseStep / (1 + adjustment));
+}
+
+/**
+ * Mixes a block of samples (usually a frame's worth) from the YM2612 and PSG and appends as many output samples as can
+ * be made from it. The last few input samples are kept for the next call.
+ *
+ * @param ym2612 - count stereo samples
+ * @param psg - count mono samples, played on both sides
+ * @param output - Interleaved stereo
+ */
+void AudioResampler::process(const int16_t *ym2612, const int16_t *psg, size_t count, std::vector<int16_t> &output) {
+    size_t start = history[0].size();
+    size_t length = start + count;
+    history[0].resize(length);
+    history[1].resize(length);
+
+    for (size_t i = 0; i < count; i++) {
+        history[0][start + i] = (int16_t)std::clamp(ym2612[i * 2] + psg[i], -32768, 32767);
+        history[1][start + i] = (int16_t)std::clamp(ym2612[i * 2 + 1] + psg[i], -32768, 32767);
+    }
+
+    // Output samples can be made up to where the filter would run past the end of the input
+    if (length < AUDIO_RESAMPLER_TAPS) {
+        return;
+    }
+
+    uint64_t end = (uint64_t)(length - AUDIO_RESAMPLER_TAPS + 1) << 32;
+
+    if (position >= end) {
+        return;
+    }
+
+    size_t outputStart = output.size();
+    output.resize(outputStart + ((end - position + step - 1) / step) * 2);
+
+    const int16_t *left = history[0].data();
+    const int16_t *right = history[1].data();
+    int16_t *target = &output[outputStart];
+    size_t produced;
+
+#ifdef AUDIO_RESAMPLER_AVX2
+    if (vectorised && avx2Supported) {
+        produced = resampleAVX2(left, right, length, position, step, coefficients.data(), target);
+    } else
+#endif
+#ifdef AUDIO_RESAMPLER_SSE2
+    if (vectorised) {
+        produced = resampleSSE2(left, right, length, position, step, coefficients.data(), target);
+    } else
+#endif
+    {
+        produced = resampleScalar(left, right, length, position, step, coefficients.data(), target);
+    }
+
+    output.resize(outputStart + produced * 2);
+
+    // Drop the input no later output sample needs
+    size_t consumed = position >> 32;
+    history[0].erase(history[0].begin(), history[0].begin() + consumed);
+    history[1].erase(history[1].begin(), history[1].begin() + consumed);
+    position -= (uint64_t)consumed << 32;
+}
+
+void AudioResampler::setVectorised(bool enabled) {
+    vectorised = enabled;
+}
+
+const char *AudioResampler::getImplementationName() {
+#ifdef AUDIO_RESAMPLER_AVX2
+    if (avx2Supported) {
+        return "AVX2";
+    }
+#endif
+
+#ifdef AUDIO_RESAMPLER_SSE2
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+
+/**
+ * A Blackman windowed sinc for each phase. Each phase is scaled so its taps add up to exactly 1 << 14, so a constant
+ * input comes out unchanged.
+ */
+void AudioResampler::buildFilter() {
+    double inputRate = (double)MASTER_CLOCK_RATE / YM2612_MASTER_CYCLES_PER_SAMPLE;
+    double cutoff = AUDIO_RESAMPLER_CUTOFF * std::min(inputRate, (double)outputRate) / inputRate;
+    double halfWidth = AUDIO_RESAMPLER_TAPS / 2;
+    coefficients.resize(AUDIO_RESAMPLER_PHASES * AUDIO_RESAMPLER_TAPS);
+
+    for (int phase = 0; phase < AUDIO_RESAMPLER_PHASES; phase++) {
+        double values[AUDIO_RESAMPLER_TAPS];
+        double total = 0;
+
+        for (int tap = 0; tap < AUDIO_RESAMPLER_TAPS; tap++) {
+            // Distance in input samples from the output sample, which sits between taps 15 and 16
+            double x = tap - (halfWidth - 1) - (double)phase / AUDIO_RESAMPLER_PHASES;
+            double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+            double window = 0.42 + 0.5 * cos(M_PI * x / halfWidth) + 0.08 * cos(2 * M_PI * x / halfWidth);
+            values[tap] = sinc * window;
+            total += values[tap];
+        }
+
+        // Round the running total rather than each tap, so the rounding errors can't add up
+        double runningTotal = 0;
+        long previous = 0;
+
+        for (int tap = 0; tap < AUDIO_RESAMPLER_TAPS; tap++) {
+            runningTotal += values[tap];
+            long rounded = lround(runningTotal * (1 << AUDIO_RESAMPLER_COEFFICIENT_BITS) / total);
+            coefficients[phase * AUDIO_RESAMPLER_TAPS + tap] = (int16_t)(rounded - previous);
+            previous = rounded;
+        }
+    }
+}
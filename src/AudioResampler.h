@@ -0,0 +1,70 @@
+#ifndef MEGANOSTALGIA_AUDIORESAMPLER_H
+#define MEGANOSTALGIA_AUDIORESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+// Input samples each output sample is made from
+#define AUDIO_RESAMPLER_TAPS 32
+
+// The filter is stored for 2^AUDIO_RESAMPLER_PHASE_BITS positions between two input samples
+#define AUDIO_RESAMPLER_PHASE_BITS 9
+#define AUDIO_RESAMPLER_PHASES (1 << AUDIO_RESAMPLER_PHASE_BITS)
+
+// Filter coefficients are 1.14 fixed point
+#define AUDIO_RESAMPLER_COEFFICIENT_BITS 14
+
+// How far the output rate can be nudged either way to keep audio in step with the display
+#define AUDIO_RESAMPLER_MAX_ADJUSTMENT 0.005
+
+/**
+ * Mixes the YM2612 and PSG output and converts it from their native rate (master clock / 1008, ~53.3KHz) to the host's
+ * output rate.
+ *
+ * A polyphase FIR filter is used: a windowed sinc, cut off below the lower of the two Nyquist frequencies, is stored in
+ * 1.14 fixed point for each of AUDIO_RESAMPLER_PHASES positions between input samples. Each output sample is the dot
+ * product of the nearest phase with the last AUDIO_RESAMPLER_TAPS input samples, which the SSE2 and AVX2 versions work
+ * out with 16 bit multiply-adds. All of them give exactly the same output as the scalar version.
+ *
+ * The position in the input is kept in 32.32 fixed point, so the rate can be adjusted slightly between calls without
+ * any jump in the output.
+ */
+class AudioResampler {
+public:
+
+    explicit AudioResampler(int outputRate);
+
+    void reset();
+
+    int getOutputRate();
+
+    void setRateAdjustment(double adjustment);
+
+    void process(const int16_t *ym2612, const int16_t *psg, size_t count, std::vector<int16_t> &output);
+
+    void setVectorised(bool enabled);
+
+    static const char *getImplementationName();
+
+private:
+
+    int outputRate;
+
+    // Input samples per output sample, 32.32 fixed point. The step is the base step with the rate adjustment applied.
+    uint64_t baseStep;
+    uint64_t step;
+
+    // Position of the next output sample from the start of the history
+    uint64_t position;
+
+    // Mixed input, one buffer per side so the dot products read contiguous samples
+    std::vector<int16_t> history[2];
+
+    std::vector<int16_t> coefficients;
+
+    bool vectorised;
+
+    void buildFilter();
+};
+
+#endif //MEGANOSTALGIA_AUDIORESAMPLER_H
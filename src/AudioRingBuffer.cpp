@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstring>
+#include "AudioRingBuffer.h"
+
+/**
+ * @param frames - Rounded up to a power of two
+ */
+AudioRingBuffer::AudioRingBuffer(size_t frames) {
+    size_t capacity = 1;
+
+    while (capacity < frames) {
+        capacity <<= 1;
+    }
+
+    buffer.resize(capacity * AUDIO_CHANNELS);
+    mask = capacity - 1;
+    writeIndex = 0;
+    readIndex = 0;
+}
+
+size_t AudioRingBuffer::getCapacity() {
+    return mask + 1;
+}
+
+/**
+ * Producer only. Never waits, anything that doesn't fit is left out.
+ *
+ * @return Number of frames written
+ */
+size_t AudioRingBuffer::write(const int16_t *samples, size_t frames) {
+    size_t writePosition = writeIndex.load(std::memory_order_relaxed);
+    size_t readPosition = readIndex.load(std::memory_order_acquire);
+    frames = std::min(frames, getCapacity() - (writePosition - readPosition));
+
+    // Up to the end of the buffer, then the rest from the start
+    size_t start = writePosition & mask;
+    size_t firstPart = std::min(frames, getCapacity() - start);
+    memcpy(&buffer[start * AUDIO_CHANNELS], samples, firstPart * AUDIO_CHANNELS * sizeof(int16_t));
+    memcpy(buffer.data(), samples + firstPart * AUDIO_CHANNELS, (frames - firstPart) * AUDIO_CHANNELS * sizeof(int16_t));
+
+    writeIndex.store(writePosition + frames, std::memory_order_release);
+    return frames;
+}
+
+/**
+ * Consumer only. Points at the frames waiting to be read, as far as the end of the buffer, which stay valid until
+ * consume is called.
+ *
+ * @return Number of frames the pointer covers, there may be more after wrapping around
+ */
+size_t AudioRingBuffer::getReadRegion(const int16_t *&samples) {
+    size_t readPosition = readIndex.load(std::memory_order_relaxed);
+    size_t writePosition = writeIndex.load(std::memory_order_acquire);
+    size_t start = readPosition & mask;
+    samples = &buffer[start * AUDIO_CHANNELS];
+    return std::min(writePosition - readPosition, getCapacity() - start);
+}
+
+/**
+ * Consumer only. Hands frames from the read region back to the producer.
+ */
+void AudioRingBuffer::consume(size_t frames) {
+    readIndex.store(readIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+
+/**
+ * Consumer only. Copies out up to the given number of frames.
+ *
+ * @return Number of frames read
+ */
+size_t AudioRingBuffer::read(int16_t *samples, size_t frames) {
+    size_t total = 0;
+
+    // At most two regions, before and after wrapping around
+    for (int i = 0; i < 2 && total < frames; i++) {
+        const int16_t *region;
+        size_t available = std::min(getReadRegion(region), frames - total);
+        memcpy(samples + total * AUDIO_CHANNELS, region, available * AUDIO_CHANNELS * sizeof(int16_t));
+        consume(available);
+        total += available;
+    }
+
+    return total;
+}
+
+/**
+ * Frames waiting to be read, either side may call this
+ */
+size_t AudioRingBuffer::getAvailable() {
+    return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+}
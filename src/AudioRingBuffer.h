@@ -0,0 +1,47 @@
+#ifndef MEGANOSTALGIA_AUDIORINGBUFFER_H
+#define MEGANOSTALGIA_AUDIORINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A frame is one sample for each side
+#define AUDIO_CHANNELS 2
+
+/**
+ * Hands interleaved int16 stereo frames from the emulator to one consumer on another thread (a host audio callback or
+ * a file writer) without locking. Only one thread may write and only one may read.
+ *
+ * Each side only moves its own index, publishing it with release ordering once the data it covers has been written or
+ * read. The capacity is a power of two so the indices can run freely and be masked. The consumer can read straight out
+ * of the buffer's memory with getReadRegion and consume.
+ */
+class AudioRingBuffer {
+public:
+
+    explicit AudioRingBuffer(size_t frames);
+
+    size_t getCapacity();
+
+    size_t write(const int16_t *samples, size_t frames);
+
+    size_t getReadRegion(const int16_t *&samples);
+
+    void consume(size_t frames);
+
+    size_t read(int16_t *samples, size_t frames);
+
+    size_t getAvailable();
+
+private:
+
+    std::vector<int16_t> buffer;
+    size_t mask;
+
+    // Kept on separate cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> writeIndex;
+    alignas(64) std::atomic<size_t> readIndex;
+};
+
+#endif //MEGANOSTALGIA_AUDIORINGBUFFER_H
@@ -0,0 +1,1171 @@
+#include <chrono>
+#include <iostream>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "Benchmark.h"
+#include "Emulator.h"
+#include "VDPCompositor.h"
+#include "VGMPlayer.h"
+
+// Where the DMA benchmark sends its full length transfer, anywhere but the start of VRAM
+#define DMA_BENCHMARK_WRAP_ADDRESS 0x1234
+
+// Number of different lines of random layer data the compositor benchmark cycles through
+#define COMPOSITOR_BENCHMARK_LINES 64
+
+// Samples generated between key on/off changes in the YM2612 benchmark
+#define YM2612_BENCHMARK_BLOCK_SIZE 4096
+
+// The PSG is caught up a frame at a time, as the emulator does
+#define PSG_BENCHMARK_FRAME_CYCLES (MASTER_CYCLES_PER_LINE * LINES_PER_FRAME)
+
+// Input samples per frame, which is how much the emulator resamples at a time
+#define RESAMPLER_BENCHMARK_FRAME_SAMPLES (PSG_BENCHMARK_FRAME_CYCLES / YM2612_MASTER_CYCLES_PER_SAMPLE)
+
+// Master cycles between status reads in the audio timing benchmark, roughly a Z80 polling loop
+#define AUDIO_TIMING_BENCHMARK_POLL_CYCLES (12 * Z80_CLOCK_DIVIDER)
+
+// Timer A reload value for the audio timing benchmark's driver, overflowing every 200 samples
+#define AUDIO_TIMING_BENCHMARK_TIMER_A (1024 - 200)
+
+// Z80 RAM used by the Z80 sound benchmark's driver, for its counters and the samples it plays through the DAC
+#define Z80_SOUND_BENCHMARK_DAC_WRITES 0x1F00
+#define Z80_SOUND_BENCHMARK_TIMER_OVERFLOWS 0x1F02
+#define Z80_SOUND_BENCHMARK_SAMPLES 0x1000
+
+// Writes standing in for the 68k's in the Z80 sound benchmark, to the noise channel's volume so they can be told apart
+#define Z80_SOUND_BENCHMARK_M68K_WRITES_PER_SLICE 4
+#define Z80_SOUND_BENCHMARK_M68K_PSG_LATCH 0xF0
+
+// Frames run before the save state benchmark takes its snapshot
+#define SAVE_STATE_BENCHMARK_WARM_UP_FRAMES 60
+
+// Save and restore pairs timed by the save state benchmark, and how long each pair should take at most
+#define SAVE_STATE_BENCHMARK_ITERATIONS 10000
+#define SAVE_STATE_BENCHMARK_TARGET_MICROSECONDS 10.0
+
+// Sound driver used by the Z80 sound and save state benchmarks. The timer A reload value is
+// AUDIO_TIMING_BENCHMARK_TIMER_A, the counters are at Z80_SOUND_BENCHMARK_DAC_WRITES and
+// Z80_SOUND_BENCHMARK_TIMER_OVERFLOWS and the samples at Z80_SOUND_BENCHMARK_SAMPLES.
+static const unsigned char z80SoundDriver[] = {
+        0x31, 0x00, 0x1F,                       // ld sp,1F00h
+        0x11, 0xCE, 0x24,                       // ld de,24CEh, timer A high bits
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x11, 0x00, 0x25,                       // ld de,2500h, timer A low bits
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x11, 0x15, 0x27,                       // ld de,2715h, load timer A and enable its flag
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x11, 0x80, 0x2B,                       // ld de,2B80h, DAC on
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x21, 0x00, 0x10,                       // ld hl,1000h, sample table
+
+        // loop:
+        0x16, 0x2A,                             // ld d,2Ah
+        0x5E,                                   // ld e,(hl)
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x2C,                                   // inc l
+        0x5E,                                   // ld e,(hl), straight away so this has to wait for the busy flag
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x2C,                                   // inc l
+        0xED, 0x4B, 0x00, 0x1F,                 // ld bc,(1F00h), DAC writes
+        0x03,                                   // inc bc
+        0x03,                                   // inc bc
+        0xED, 0x43, 0x00, 0x1F,                 // ld (1F00h),bc
+        0x3A, 0x00, 0x40,                       // ld a,(4000h)
+        0xE6, 0x01,                             // and 1, timer A overflowed?
+        0x28, 0xE3,                             // jr z,loop
+        0xED, 0x4B, 0x02, 0x1F,                 // ld bc,(1F02h), timer A overflows
+        0x03,                                   // inc bc
+        0xED, 0x43, 0x02, 0x1F,                 // ld (1F02h),bc
+        0x79,                                   // ld a,c
+        0xE6, 0x0F,                             // and 0Fh
+        0xF6, 0x90,                             // or 90h, PSG channel 0 volume
+        0x32, 0x11, 0x7F,                       // ld (7F11h),a
+        0x11, 0x15, 0x27,                       // ld de,2715h, acknowledge timer A
+        0xCD, 0x54, 0x00,                       // call ymwrite
+        0x18, 0xCA,                             // jr loop
+
+        // ymwrite: writes E to register D, waiting for the busy flag first
+        0x3A, 0x00, 0x40,                       // ld a,(4000h), wait while busy
+        0x17,                                   // rla
+        0x38, 0xFA,                             // jr c,ymwrite
+        0x7A,                                   // ld a,d
+        0x32, 0x00, 0x40,                       // ld (4000h),a
+        0x7B,                                   // ld a,e
+        0x32, 0x01, 0x40,                       // ld (4001h),a
+        0xC9,                                   // ret
+};
+
+/**
+ * [Benchmark::runVDP Renders a busy scene (scrolling planes, window and a full sprite table) in each pixel format and
+ * reports lines/second. Render skipping is turned off, the scene never changes so every frame would be reused.]
+ * @param lines [Number of lines to render in each format]
+ */
+void Benchmark::runVDP(uint64_t lines) {
+    const VDPPixelFormat formats[] = {VDPPixelFormat::XRGB8888, VDPPixelFormat::RGB565, VDPPixelFormat::Indexed8};
+    const char *formatNames[] = {"XRGB8888", "RGB565", "Indexed8"};
+
+    for (int format = 0; format < 3; format++) {
+        VDP *vdp = new VDP();
+        vdp->setPixelFormat(formats[format]);
+        vdp->setRenderSkipEnabled(false);
+        setUpVDPScene(*vdp);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < lines; i++) {
+            vdp->startLine((int)(i % VDP_SCREEN_HEIGHT));
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        // Checksum of the final frame, so changes to the renderer can be checked for identical output
+        uint32_t checksum = getFramebufferChecksum(*vdp);
+
+        std::cout << formatNames[format] << ":" << std::endl <<
+                  "VDP lines rendered: " << vdp->getLinesRendered() << std::endl <<
+                  "Tiles decoded: " << vdp->getTilesDecoded() << std::endl <<
+                  "Time taken: " << seconds << "s" << std::endl <<
+                  "Lines per second: " << (uint64_t)(lines / seconds) << std::endl <<
+                  "Frames per second: " << (uint64_t)(lines / seconds / VDP_SCREEN_HEIGHT) << std::endl <<
+                  "Framebuffer size: " << vdp->getFramebufferPitch() * VDP_SCREEN_HEIGHT << " bytes" << std::endl <<
+                  "Framebuffer checksum: " << std::hex << checksum << std::dec << std::endl;
+
+        delete vdp;
+    }
+
+    // Static scene with render skipping on, every frame after the first should be reused
+    VDP *vdp = new VDP();
+    setUpVDPScene(*vdp);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < lines; i++) {
+        vdp->startLine((int)(i % VDP_SCREEN_HEIGHT));
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "Render skip:" << std::endl <<
+              "VDP frames rendered: " << vdp->getFramesRendered() << std::endl <<
+              "VDP frames reused: " << vdp->getFramesReused() << std::endl <<
+              "Time taken: " << seconds << "s" << std::endl <<
+              "Lines per second: " << (uint64_t)(lines / seconds) << std::endl;
+
+    delete vdp;
+
+    // Rendering on a separate thread, includes waiting for the last frame to be drawn. The checksum should match the
+    // XRGB8888 one above.
+    vdp = new VDP();
+    vdp->setRenderSkipEnabled(false);
+    vdp->setRenderThreaded(true);
+    setUpVDPScene(*vdp);
+
+    start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < lines; i++) {
+        vdp->startLine((int)(i % VDP_SCREEN_HEIGHT));
+    }
+
+    uint32_t checksum = getFramebufferChecksum(*vdp);
+    end = std::chrono::steady_clock::now();
+    seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "Threaded:" << std::endl <<
+              "VDP lines rendered: " << vdp->getLinesRendered() << std::endl <<
+              "Time taken: " << seconds << "s" << std::endl <<
+              "Lines per second: " << (uint64_t)(lines / seconds) << std::endl <<
+              "Framebuffer checksum: " << std::hex << checksum << std::dec << std::endl;
+
+    delete vdp;
+}
+
+/**
+ * [Benchmark::getFramebufferChecksum FNV-1a hash of the whole framebuffer]
+ * @param vdp [VDP to hash the framebuffer of]
+ * @return [The hash]
+ */
+uint32_t Benchmark::getFramebufferChecksum(VDP &vdp) {
+    uint32_t checksum = 2166136261u;
+    const unsigned char *framebuffer = vdp.getFramebuffer();
+
+    for (int i = 0; i < vdp.getFramebufferPitch() * VDP_SCREEN_HEIGHT; i++) {
+        checksum = (checksum ^ framebuffer[i]) * 16777619u;
+    }
+
+    return checksum;
+}
+
+/**
+ * Times VRAM sized 68k transfers, alternating between 68k RAM and (empty) ROM so that each one changes VRAM. Then checks
+ * that a full length transfer (a length of 0 is 0x10000 words) to the middle of VRAM wraps around it twice without
+ * touching anything after it.
+ */
+void Benchmark::runDMA(uint64_t transfers) {
+    auto *cartridge = new Cartridge();
+    auto *vdp = new VDP();
+    auto *memory = new Memory(cartridge, vdp, nullptr, nullptr);
+    auto *before = new VDPSaveStateData();
+    auto *after = new VDPSaveStateData();
+    uint32_t seed = 1;
+    vdp->setMemory(memory);
+
+    for (uint32_t i = 0; i < M68K_RAM_SIZE; i += 2) {
+        memory->m68kWrite(0xFF0000 + i, (unsigned short)(nextRandom(seed) | 0x0101));
+    }
+
+    auto runDMA = [vdp](uint32_t source, uint32_t words, uint16_t destination) {
+        vdp->writeControl(0x8114);
+        vdp->writeControl(0x8F02);
+        vdp->writeControl(0x9300 | (words & 0xFF));
+        vdp->writeControl(0x9400 | ((words >> 8) & 0xFF));
+        vdp->writeControl(0x9500 | ((source >> 1) & 0xFF));
+        vdp->writeControl(0x9600 | ((source >> 9) & 0xFF));
+        vdp->writeControl(0x9700 | ((source >> 17) & 0x7F));
+        vdp->writeControl(0x4000 | (destination & 0x3FFF));
+        vdp->writeControl(0x0080 | (destination >> 14));
+        vdp->takeM68kStallCycles();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < transfers; i++) {
+        runDMA((i & 1) ? 0x000000 : 0xFF0000, VDP_VRAM_SIZE / 2, 0);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // VRAM full of RAM data and everything after it set to something, then zeros from ROM across all of it
+    runDMA(0xFF0000, VDP_VRAM_SIZE / 2, 0);
+    vdp->writeControl(0xC000);
+    vdp->writeControl(0x0000);
+
+    for (int i = 0; i < VDP_CRAM_SIZE; i++) {
+        vdp->writeData((uint16_t)(nextRandom(seed) & 0x0EEE));
+    }
+
+    vdp->writeControl(0x4000);
+    vdp->writeControl(0x0010);
+
+    for (int i = 0; i < VDP_VSRAM_SIZE; i++) {
+        vdp->writeData((uint16_t)(nextRandom(seed) & 0x07FF));
+    }
+
+    vdp->getSaveStateData(*before);
+    runDMA(0x000000, 0, DMA_BENCHMARK_WRAP_ADDRESS);
+    vdp->getSaveStateData(*after);
+
+    bool cleared = std::all_of(after->vram, after->vram + VDP_VRAM_SIZE, [](unsigned char value) {
+        return value == 0;
+    });
+    bool untouched = memcmp(before->cram, after->cram, sizeof(before->cram)) == 0 &&
+            memcmp(before->vsram, after->vsram, sizeof(before->vsram)) == 0;
+
+    std::cout << "VRAM sized transfers per second: " << (uint64_t)(transfers / seconds) << " (" <<
+              transfers / seconds * VDP_VRAM_SIZE / 1048576 << "MB/s)" << std::endl <<
+              "Full length transfer to 0x" << std::hex << DMA_BENCHMARK_WRAP_ADDRESS << ": VRAM " <<
+              (cleared ? "all written" : "NOT all written") << ", CRAM and VSRAM " <<
+              (untouched ? "untouched" : "OVERWRITTEN") << ", ends at 0x" << after->address << std::dec << std::endl <<
+              "Result: " << (cleared && untouched && after->address == DMA_BENCHMARK_WRAP_ADDRESS ? "passed" : "FAILED") <<
+              std::endl;
+
+    delete before;
+    delete after;
+    delete memory;
+    delete vdp;
+    delete cartridge;
+}
+
+/**
+ * [Benchmark::runCompositor Times the line compositor against the scalar reference at 320 pixels wide, with and without
+ * shadow/highlight, and checks that they produce identical output]
+ * @param lines [Number of lines to compose with each implementation and mode]
+ */
+void Benchmark::runCompositor(uint64_t lines) {
+    // Plane A, plane B and sprite buffers for each line
+    auto *layers = new unsigned char[COMPOSITOR_BENCHMARK_LINES * 3 * VDP_SCREEN_WIDTH];
+    auto *scalarOutput = new unsigned char[COMPOSITOR_BENCHMARK_LINES * VDP_SCREEN_WIDTH];
+    auto *output = new unsigned char[COMPOSITOR_BENCHMARK_LINES * VDP_SCREEN_WIDTH];
+    uint32_t seed = 12345;
+
+    // Mostly opaque planes with some transparency, sparser sprites with a few shadow/highlight operators
+    for (int i = 0; i < COMPOSITOR_BENCHMARK_LINES * 3 * VDP_SCREEN_WIDTH; i++) {
+        uint32_t random = nextRandom(seed);
+        bool sprite = (i / VDP_SCREEN_WIDTH) % 3 == 2;
+        layers[i] = (sprite && (random & 0x300)) ? 0 : random & 0xBF;
+    }
+
+    // Every vectorised version this build and CPU can run is checked, not just the one normally used
+    const VDPCompositorImplementation implementations[] = {VDPCompositorImplementation::SSE2, VDPCompositorImplementation::AVX2};
+    VDPCompositorImplementation fastest = VDPCompositor::getImplementation();
+
+    std::cout << "Compositor: " << VDPCompositor::getImplementationName() << std::endl;
+
+    for (int shadowHighlight = 0; shadowHighlight < 2; shadowHighlight++) {
+        double scalarSeconds = timeCompositor(true, shadowHighlight, lines, layers, scalarOutput);
+
+        for (VDPCompositorImplementation implementation : implementations) {
+            if (!VDPCompositor::isSupported(implementation)) {
+                continue;
+            }
+
+            VDPCompositor::setImplementation(implementation);
+            double seconds = timeCompositor(false, shadowHighlight, lines, layers, output);
+            bool identical = memcmp(scalarOutput, output, COMPOSITOR_BENCHMARK_LINES * VDP_SCREEN_WIDTH) == 0;
+
+            std::cout << (shadowHighlight ? "Shadow/highlight: " : "Normal: ") <<
+                      "scalar " << scalarSeconds * 1e9 / lines << "ns/line, " <<
+                      VDPCompositor::getImplementationName() << " " << seconds * 1e9 / lines << "ns/line, " <<
+                      "speedup " << scalarSeconds / seconds << "x, " <<
+                      "output " << (identical ? "identical" : "DIFFERENT") << std::endl;
+        }
+    }
+
+    VDPCompositor::setImplementation(fastest);
+
+    delete[] layers;
+    delete[] scalarOutput;
+    delete[] output;
+}
+
+double Benchmark::timeCompositor(bool scalar, bool shadowHighlight, uint64_t lines, unsigned char *layers, unsigned char *output) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < lines; i++) {
+        int line = (int)(i % COMPOSITOR_BENCHMARK_LINES);
+        const unsigned char *planeA = &layers[line * 3 * VDP_SCREEN_WIDTH];
+        const unsigned char *planeB = planeA + VDP_SCREEN_WIDTH;
+        const unsigned char *sprites = planeB + VDP_SCREEN_WIDTH;
+        unsigned char *lineOutput = &output[line * VDP_SCREEN_WIDTH];
+
+        if (scalar) {
+            VDPCompositor::composeScalar(planeA, planeB, sprites, lineOutput, VDP_SCREEN_WIDTH, 0x10, shadowHighlight);
+        } else {
+            VDPCompositor::compose(planeA, planeB, sprites, lineOutput, VDP_SCREEN_WIDTH, 0x10, shadowHighlight);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * [Benchmark::runYM2612 Times the YM2612 with every channel playing, vectorised and scalar, and checks that both produce
+ * identical output]
+ * @param samples [Number of stereo samples to generate with each implementation]
+ */
+void Benchmark::runYM2612(uint64_t samples) {
+    std::vector<int16_t> reference;
+    std::vector<int16_t> output;
+
+    double scalarSeconds = timeYM2612(false, samples, reference);
+    double seconds = timeYM2612(true, samples, output);
+    uint64_t differences = 0;
+    uint32_t checksum = 2166136261u;
+
+    for (size_t i = 0; i < output.size(); i++) {
+        differences += output[i] != reference[i];
+        checksum = (checksum ^ (uint16_t)output[i]) * 16777619u;
+    }
+
+    double sampleRate = 53693175.0 / YM2612_MASTER_CYCLES_PER_SAMPLE;
+
+    std::cout << "YM2612: " << YM2612::getImplementationName() << std::endl <<
+              "Scalar samples per second: " << (uint64_t)(samples / scalarSeconds) << " (" <<
+              samples / scalarSeconds / sampleRate << "x real time)" << std::endl <<
+              YM2612::getImplementationName() << " samples per second: " << (uint64_t)(samples / seconds) << " (" <<
+              samples / seconds / sampleRate << "x real time)" << std::endl <<
+              "Speedup: " << scalarSeconds / seconds << "x" << std::endl <<
+              "Samples different from the scalar reference: " << differences << std::endl <<
+              "Output checksum: " << std::hex << checksum << std::dec << std::endl;
+}
+
+double Benchmark::timeYM2612(bool vectorised, uint64_t samples, std::vector<int16_t> &output) {
+    auto *ym2612 = new YM2612();
+    ym2612->setVectorised(vectorised);
+    setUpYM2612Scene(*ym2612);
+    output.resize(samples * 2);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < samples; i += YM2612_BENCHMARK_BLOCK_SIZE) {
+        // Retrigger one channel each block so that the envelopes keep moving
+        static const unsigned char channels[6] = {0, 1, 2, 4, 5, 6};
+        unsigned char channel = channels[(i / YM2612_BENCHMARK_BLOCK_SIZE) % 6];
+        writeYM2612Register(*ym2612, 0, 0x28, channel);
+        writeYM2612Register(*ym2612, 0, 0x28, 0xF0 | channel);
+
+        int count = (int)std::min((uint64_t)YM2612_BENCHMARK_BLOCK_SIZE, samples - i);
+        ym2612->generateSamples(&output[i * 2], count);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    delete ym2612;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Every channel playing a different note with a different algorithm, feedback and envelope, with the LFO on
+ */
+void Benchmark::setUpYM2612Scene(YM2612 &ym2612) {
+    uint32_t seed = 12345;
+
+    writeYM2612Register(ym2612, 0, 0x22, 0x0B);
+
+    for (int channel = 0; channel < YM2612_CHANNELS; channel++) {
+        int part = channel / 3;
+        int offset = channel % 3;
+
+        for (int slot = 0; slot < 4; slot++) {
+            int reg = offset + slot * 4;
+            writeYM2612Register(ym2612, part, 0x30 + reg, nextRandom(seed) & 0x7F);
+            writeYM2612Register(ym2612, part, 0x40 + reg, nextRandom(seed) & 0x3F);
+            writeYM2612Register(ym2612, part, 0x50 + reg, (nextRandom(seed) & 0xC0) | (16 + (nextRandom(seed) & 0x0F)));
+            writeYM2612Register(ym2612, part, 0x60 + reg, (nextRandom(seed) & 0x80) | (nextRandom(seed) & 0x1F));
+            writeYM2612Register(ym2612, part, 0x70 + reg, nextRandom(seed) & 0x1F);
+            writeYM2612Register(ym2612, part, 0x80 + reg, nextRandom(seed) & 0xFF);
+        }
+
+        writeYM2612Register(ym2612, part, 0xA4 + offset, 0x20 | ((channel * 3) & 0x07));
+        writeYM2612Register(ym2612, part, 0xA0 + offset, nextRandom(seed) & 0xFF);
+        writeYM2612Register(ym2612, part, 0xB0 + offset, (channel & 0x07) | ((channel + 1) << 3));
+        writeYM2612Register(ym2612, part, 0xB4 + offset, 0xC0 | (channel << 3) | channel);
+    }
+
+    for (unsigned char channel : {0, 1, 2, 4, 5, 6}) {
+        writeYM2612Register(ym2612, 0, 0x28, 0xF0 | channel);
+    }
+}
+
+void Benchmark::writeYM2612Register(YM2612 &ym2612, int part, int reg, unsigned char value) {
+    ym2612.write(part * 2, reg);
+    ym2612.write(part * 2 + 1, value);
+}
+
+/**
+ * The PSG's cost goes with how often its outputs change, so the same amount of audio is timed with the tone channels at
+ * a low pitch through to a very high one
+ */
+void Benchmark::runPSG(uint64_t samples) {
+    static const uint16_t periods[4] = {0x3FF, 0x100, 0x20, 0x04};
+    double sampleRate = 53693175.0 / SN76489_MASTER_CYCLES_PER_SAMPLE;
+    uint32_t checksum = 2166136261u;
+
+    for (uint16_t period : periods) {
+        auto *psg = new SN76489();
+
+        // Each tone channel a little apart, at different volumes, with white noise
+        for (int channel = 0; channel < 3; channel++) {
+            uint16_t channelPeriod = period - channel * (period / 8);
+            psg->write(0x80 | (channel << 5) | (channelPeriod & 0x0F));
+            psg->write((channelPeriod >> 4) & 0x3F);
+            psg->write(0x90 | (channel << 5) | (channel * 2));
+        }
+
+        psg->write(0xE4);
+        psg->write(0xF3);
+
+        uint64_t masterClock = 0;
+        uint64_t endTime = samples * SN76489_MASTER_CYCLES_PER_SAMPLE;
+        auto start = std::chrono::steady_clock::now();
+
+        while (masterClock < endTime) {
+            masterClock = std::min(masterClock + PSG_BENCHMARK_FRAME_CYCLES, endTime);
+            psg->catchUp(masterClock);
+
+            for (int16_t sample : psg->getOutput()) {
+                checksum = (checksum ^ (uint16_t)sample) * 16777619u;
+            }
+
+            psg->clearOutput();
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Tone period " << period << ": " << (uint64_t)(psg->getSamplesGenerated() / seconds) <<
+                  " samples per second (" << psg->getSamplesGenerated() / seconds / sampleRate << "x real time), " <<
+                  psg->getTransitions() << " transitions" << std::endl;
+
+        delete psg;
+    }
+
+    std::cout << "Output checksum: " << std::hex << checksum << std::dec << std::endl;
+}
+
+/**
+ * Resamples the same input with the scalar and vectorised filters. The rate adjustment swings back and forth as it
+ * would when keeping in step with the display.
+ */
+void Benchmark::runResampler(uint64_t frames) {
+    std::vector<int16_t> ym2612(RESAMPLER_BENCHMARK_FRAME_SAMPLES * 2 * 64);
+    std::vector<int16_t> psg(RESAMPLER_BENCHMARK_FRAME_SAMPLES * 64);
+    uint32_t seed = 12345;
+
+    // A few tones and some noise, 64 frames of it to cycle through
+    for (size_t i = 0; i < psg.size(); i++) {
+        ym2612[i * 2] = (int16_t)(((i * 37) % 512) * 24 - 6144 + (nextRandom(seed) & 0x3FF));
+        ym2612[i * 2 + 1] = (int16_t)(((i * 53) % 700) * 16 - 5600);
+        psg[i] = (int16_t)((i / 60) % 2 ? 2048 : -2048);
+    }
+
+    std::vector<int16_t> reference;
+    std::vector<int16_t> output;
+    double scalarSeconds = timeResampler(false, frames, ym2612, psg, reference);
+    double seconds = timeResampler(true, frames, ym2612, psg, output);
+    uint64_t differences = reference.size() != output.size();
+    uint32_t checksum = 2166136261u;
+
+    for (size_t i = 0; i < std::min(output.size(), reference.size()); i++) {
+        differences += output[i] != reference[i];
+        checksum = (checksum ^ (uint16_t)output[i]) * 16777619u;
+    }
+
+    double frameRate = 53693175.0 / PSG_BENCHMARK_FRAME_CYCLES;
+
+    std::cout << "Resampler: " << AudioResampler::getImplementationName() << ", to " << EMULATOR_AUDIO_RATE << "Hz" << std::endl <<
+              "Scalar frames per second: " << (uint64_t)(frames / scalarSeconds) << " (" <<
+              frames / scalarSeconds / frameRate << "x real time)" << std::endl <<
+              AudioResampler::getImplementationName() << " frames per second: " << (uint64_t)(frames / seconds) << " (" <<
+              frames / seconds / frameRate << "x real time)" << std::endl <<
+              "Speedup: " << scalarSeconds / seconds << "x" << std::endl <<
+              "Samples different from the scalar reference: " << differences << std::endl <<
+              "Output checksum: " << std::hex << checksum << std::dec << std::endl;
+}
+
+double Benchmark::timeResampler(bool vectorised, uint64_t frames, const std::vector<int16_t> &ym2612,
+                                const std::vector<int16_t> &psg, std::vector<int16_t> &output) {
+    auto *resampler = new AudioResampler(EMULATOR_AUDIO_RATE);
+    resampler->setVectorised(vectorised);
+    output.clear();
+    output.reserve(frames * (EMULATOR_AUDIO_RATE / 50) * 2);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        size_t offset = (frame % 64) * RESAMPLER_BENCHMARK_FRAME_SAMPLES;
+        resampler->setRateAdjustment((frame % 120 < 60 ? 1 : -1) * AUDIO_RESAMPLER_MAX_ADJUSTMENT);
+        resampler->process(&ym2612[offset * 2], &psg[offset], RESAMPLER_BENCHMARK_FRAME_SAMPLES, output);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    delete resampler;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Runs a sound driver that waits on timer A and the busy flag, with full synthesis and then in timing only mode. The
+ * driver must see exactly the same status values either way.
+ */
+void Benchmark::runAudioTiming(uint64_t frames) {
+    uint32_t fullChecksum;
+    uint32_t timingOnlyChecksum;
+    double fullSeconds = timeAudioTiming(false, frames, fullChecksum);
+    double timingOnlySeconds = timeAudioTiming(true, frames, timingOnlyChecksum);
+    double frameRate = 53693175.0 / PSG_BENCHMARK_FRAME_CYCLES;
+
+    std::cout << "Full synthesis frames per second: " << (uint64_t)(frames / fullSeconds) << " (" <<
+              frames / fullSeconds / frameRate << "x real time)" << std::endl <<
+              "Timing only frames per second: " << (uint64_t)(frames / timingOnlySeconds) << " (" <<
+              frames / timingOnlySeconds / frameRate << "x real time)" << std::endl <<
+              "Speedup: " << fullSeconds / timingOnlySeconds << "x" << std::endl <<
+              "Full synthesis status checksum: " << std::hex << fullChecksum << std::endl <<
+              "Timing only status checksum: " << timingOnlyChecksum << std::dec << std::endl;
+}
+
+/**
+ * @param checksum - Of every status value the driver read
+ */
+double Benchmark::timeAudioTiming(bool timingOnly, uint64_t frames, uint32_t &checksum) {
+    auto *ym2612 = new YM2612();
+    auto *psg = new SN76489();
+    auto *resampler = new AudioResampler(EMULATOR_AUDIO_RATE);
+    std::vector<int16_t> output;
+    uint64_t masterClock = 0;
+    uint64_t ticks = 0;
+    checksum = 2166136261u;
+
+    ym2612->setAccessClock(&masterClock);
+    psg->setAccessClock(&masterClock);
+    setUpYM2612Scene(*ym2612);
+    ym2612->setTimingOnly(timingOnly);
+    psg->setTimingOnly(timingOnly);
+
+    auto readStatus = [&]() {
+        unsigned char status = ym2612->readStatus();
+        checksum = (checksum ^ status) * 16777619u;
+        masterClock += AUDIO_TIMING_BENCHMARK_POLL_CYCLES;
+        return status;
+    };
+
+    // Waits for the busy flag to clear before each write, as drivers do
+    auto write = [&](int part, int reg, unsigned char value) {
+        while (readStatus() & 0x80) {
+        }
+
+        ym2612->write(part * 2, reg);
+        ym2612->write(part * 2 + 1, value);
+    };
+
+    write(0, 0x24, AUDIO_TIMING_BENCHMARK_TIMER_A >> 2);
+    write(0, 0x25, AUDIO_TIMING_BENCHMARK_TIMER_A & 0x03);
+    write(0, 0x27, 0x05);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        uint64_t frameEndTime = (frame + 1) * PSG_BENCHMARK_FRAME_CYCLES;
+
+        while (masterClock < frameEndTime) {
+            if (!(readStatus() & 0x01)) {
+                continue;
+            }
+
+            // Each tick, acknowledge the timer and move one channel on to a new note
+            static const unsigned char channels[6] = {0, 1, 2, 4, 5, 6};
+            unsigned char channel = channels[ticks % 6];
+            write(0, 0x27, 0x15);
+            write(0, 0x28, channel);
+            write(channel >> 2, 0xA4 + (channel & 3), 0x20 | (ticks & 0x07));
+            write(channel >> 2, 0xA0 + (channel & 3), (ticks * 37) & 0xFF);
+            write(0, 0x28, 0xF0 | channel);
+            psg->write(0x80 | ((ticks % 3) << 5) | (ticks & 0x0F));
+            psg->write((ticks >> 4) & 0x3F);
+            ticks++;
+        }
+
+        ym2612->catchUp(frameEndTime);
+        psg->catchUp(frameEndTime);
+
+        if (!timingOnly) {
+            const std::vector<int16_t> &ym2612Output = ym2612->getOutput();
+            const std::vector<int16_t> &psgOutput = psg->getOutput();
+            resampler->process(ym2612Output.data(), psgOutput.data(), std::min(ym2612Output.size() / 2, psgOutput.size()), output);
+            ym2612->clearOutput();
+            psg->clearOutput();
+            output.clear();
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    delete ym2612;
+    delete psg;
+    delete resampler;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Runs a Z80 sound driver through memory, as the emulator does. It streams DAC samples as fast as the busy flag allows
+ * and counts timer A overflows, which only works if the sound chips see the Z80's time as each instruction runs. A
+ * clock that only moved at the end of each slice would leave the driver waiting on the busy flag for the whole slice.
+ *
+ * Every write is recorded to a VGM file, with a few PSG writes made ahead of the Z80 in each slice as the 68k's would
+ * be. Each DAC write and each of those should get a sample of its own in the file. The file is then played back with
+ * another recording made of that, which should come out exactly the same.
+ */
+void Benchmark::runZ80Sound(uint64_t frames) {
+    auto *ym2612 = new YM2612();
+    auto *psg = new SN76489();
+    auto *memory = new Memory(nullptr, nullptr, ym2612, psg);
+    auto *z80 = new CPUZ80(memory);
+    uint64_t masterClock = 0;
+    uint64_t dacWrites = 0;
+    uint64_t timerOverflows = 0;
+    uint16_t lastDACWrites = 0;
+    uint16_t lastTimerOverflows = 0;
+    uint64_t m68kMasterClock = 0;
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string vgmFileName = (directory / "meganostalgia-z80sound.vgm").string();
+    std::string replayedFileName = (directory / "meganostalgia-z80sound-replayed.vgm").string();
+    auto *vgmWriter = new VGMWriter(vgmFileName, 0);
+
+    z80->setMasterClock(&masterClock);
+    ym2612->setVGMWriter(vgmWriter);
+    psg->setVGMWriter(vgmWriter);
+
+    for (size_t i = 0; i < sizeof(z80SoundDriver); i++) {
+        memory->z80Write((uint16_t)i, z80SoundDriver[i]);
+    }
+
+    // A sawtooth
+    for (int i = 0; i < 256; i++) {
+        memory->z80Write((uint16_t)(Z80_SOUND_BENCHMARK_SAMPLES + i), (unsigned char)i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        // Split at the vertical interrupt, as the emulator's scheduler would
+        uint64_t frameStartTime = frame * PSG_BENCHMARK_FRAME_CYCLES;
+        uint64_t frameEndTime = frameStartTime + PSG_BENCHMARK_FRAME_CYCLES;
+        uint64_t sliceEndTimes[2] = {frameStartTime + VINT_LINE * MASTER_CYCLES_PER_LINE, frameEndTime};
+
+        uint64_t sliceStartTime = frameStartTime;
+
+        for (uint64_t sliceEndTime : sliceEndTimes) {
+            // The 68k runs through the whole slice first
+            psg->setAccessClock(&m68kMasterClock);
+
+            for (int i = 0; i < Z80_SOUND_BENCHMARK_M68K_WRITES_PER_SLICE; i++) {
+                m68kMasterClock = sliceStartTime + (sliceEndTime - sliceStartTime) * i / Z80_SOUND_BENCHMARK_M68K_WRITES_PER_SLICE;
+                psg->write(Z80_SOUND_BENCHMARK_M68K_PSG_LATCH | (i & 0x0F));
+            }
+
+            ym2612->setAccessClock(&masterClock);
+            psg->setAccessClock(&masterClock);
+
+            if (masterClock < sliceEndTime) {
+                z80->run((int)((sliceEndTime - masterClock + Z80_CLOCK_DIVIDER - 1) / Z80_CLOCK_DIVIDER));
+            }
+
+            vgmWriter->commit(sliceEndTime);
+            sliceStartTime = sliceEndTime;
+
+            // The driver's counters are only 16 bit
+            uint16_t count = memory->z80Read16Bit(Z80_SOUND_BENCHMARK_DAC_WRITES);
+            dacWrites += (uint16_t)(count - lastDACWrites);
+            lastDACWrites = count;
+
+            count = memory->z80Read16Bit(Z80_SOUND_BENCHMARK_TIMER_OVERFLOWS);
+            timerOverflows += (uint16_t)(count - lastTimerOverflows);
+            lastTimerOverflows = count;
+        }
+
+        ym2612->catchUp(frameEndTime);
+        psg->catchUp(frameEndTime);
+        ym2612->clearOutput();
+        psg->clearOutput();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ym2612->setVGMWriter(nullptr);
+    psg->setVGMWriter(nullptr);
+    vgmWriter->close(frames * PSG_BENCHMARK_FRAME_CYCLES);
+    delete vgmWriter;
+
+    std::vector<unsigned char> recording = readFile(vgmFileName);
+    uint64_t recordedDACWrites;
+    uint64_t recordedM68kWrites;
+    bool spaced = checkVGMSpacing(recording, recordedDACWrites, recordedM68kWrites);
+    replayVGM(vgmFileName, replayedFileName);
+    bool replayedMatches = readFile(replayedFileName) == recording;
+    std::filesystem::remove(vgmFileName);
+    std::filesystem::remove(replayedFileName);
+
+    double frameRate = 53693175.0 / PSG_BENCHMARK_FRAME_CYCLES;
+    uint64_t expectedOverflows = frames * PSG_BENCHMARK_FRAME_CYCLES /
+            ((1024 - AUDIO_TIMING_BENCHMARK_TIMER_A) * YM2612_MASTER_CYCLES_PER_SAMPLE);
+    double dacSpacing = (double)(frames * PSG_BENCHMARK_FRAME_CYCLES) / (double)std::max(dacWrites, (uint64_t)1);
+
+    // The timer is loaded a little after the start, so may be one overflow short. Half the DAC writes wait for the busy
+    // flag, which should still leave more than one a line. If it never cleared until the end of a slice there would be
+    // one a slice.
+    bool passed = timerOverflows + 1 >= expectedOverflows && timerOverflows <= expectedOverflows &&
+            dacSpacing < MASTER_CYCLES_PER_LINE && spaced && replayedMatches;
+
+    std::cout << "Frames per second: " << (uint64_t)(frames / seconds) << " (" << frames / seconds / frameRate <<
+              "x real time)" << std::endl <<
+              "DAC writes: " << dacWrites << " (every " << (uint64_t)dacSpacing << " master cycles, busy for " <<
+              YM2612_BUSY_MASTER_CYCLES << ")" << std::endl <<
+              "Timer A overflows: " << timerOverflows << " (expected " << expectedOverflows << ")" << std::endl <<
+              "VGM DAC writes: " << recordedDACWrites << ", 68k writes: " << recordedM68kWrites << ", " <<
+              (spaced ? "each on a sample of its own" : "some sharing a sample") << std::endl <<
+              "VGM played back and recorded again: " << (replayedMatches ? "identical" : "DIFFERENT") << std::endl <<
+              "Result: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    delete z80;
+    delete memory;
+    delete ym2612;
+    delete psg;
+}
+
+/**
+ * Checks and times Emulator::saveState and restoreState. The 68k core can't run code yet, so frames are run with the Z80
+ * sound benchmark's driver on the Z80 and the VDP benchmark's scene, scrolled by writes made in place of the 68k's.
+ *
+ * After some frames the state is saved and restored into a second emulator, which must save exactly the same state
+ * again. Both are then run on, and must draw the same picture and make the same sound.
+ */
+void Benchmark::runSaveState(uint64_t frames) {
+    auto *original = new Emulator();
+    auto *restored = new Emulator();
+    auto *saved = new EmulatorSaveStateData();
+    auto *resaved = new EmulatorSaveStateData();
+    uint32_t originalVideoChecksum;
+    uint32_t originalAudioChecksum;
+    uint32_t restoredVideoChecksum;
+    uint32_t restoredAudioChecksum;
+
+    setUpSaveStateEmulator(*original);
+    runSaveStateFrames(*original, SAVE_STATE_BENCHMARK_WARM_UP_FRAMES, originalVideoChecksum, originalAudioChecksum);
+
+    // Padding is left alone by the copies, so it has to start out the same
+    memset(saved, 0, sizeof(EmulatorSaveStateData));
+    memset(resaved, 0, sizeof(EmulatorSaveStateData));
+    original->saveState(*saved);
+    restored->restoreState(*saved);
+    restored->saveState(*resaved);
+    bool stateMatches = memcmp(saved, resaved, sizeof(EmulatorSaveStateData)) == 0;
+
+    runSaveStateFrames(*original, frames, originalVideoChecksum, originalAudioChecksum);
+    runSaveStateFrames(*restored, frames, restoredVideoChecksum, restoredAudioChecksum);
+    bool videoMatches = originalVideoChecksum == restoredVideoChecksum;
+    bool audioMatches = originalAudioChecksum == restoredAudioChecksum;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < SAVE_STATE_BENCHMARK_ITERATIONS; i++) {
+        original->saveState(*saved);
+        original->restoreState(*saved);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double microseconds = seconds * 1000000.0 / SAVE_STATE_BENCHMARK_ITERATIONS;
+    bool passed = stateMatches && videoMatches && audioMatches;
+
+    std::cout << "Save state size: " << sizeof(EmulatorSaveStateData) << " bytes" << std::endl <<
+              "Save and restore: " << microseconds << "us (target " << SAVE_STATE_BENCHMARK_TARGET_MICROSECONDS <<
+              "us, " << (microseconds <= SAVE_STATE_BENCHMARK_TARGET_MICROSECONDS ? "met" : "MISSED") << ")" <<
+              std::endl <<
+              "Saved again after restoring: " << (stateMatches ? "identical" : "DIFFERENT") << std::endl <<
+              "Framebuffer checksums after " << frames << " more frames: " << std::hex << originalVideoChecksum <<
+              ", " << restoredVideoChecksum << std::endl <<
+              "Audio checksums: " << originalAudioChecksum << ", " << restoredAudioChecksum << std::dec << std::endl <<
+              "Result: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    delete saved;
+    delete resaved;
+    delete original;
+    delete restored;
+}
+
+/**
+ * Resets the emulator as init does, without a cartridge or the 68k, and loads the sound driver and the VDP scene
+ */
+void Benchmark::setUpSaveStateEmulator(Emulator &emulator) {
+    emulator.z80->reset();
+    emulator.vdp->reset();
+    emulator.ym2612->reset();
+    emulator.psg->reset();
+    emulator.resampler->reset();
+    emulator.scheduler->reset();
+    emulator.scheduler->schedule(SchedulerEvent::VInt, VINT_LINE * MASTER_CYCLES_PER_LINE);
+
+    for (size_t i = 0; i < sizeof(z80SoundDriver); i++) {
+        emulator.memory->z80Write((uint16_t)i, z80SoundDriver[i]);
+    }
+
+    // A sawtooth
+    for (int i = 0; i < 256; i++) {
+        emulator.memory->z80Write((uint16_t)(Z80_SOUND_BENCHMARK_SAMPLES + i), (unsigned char)i);
+    }
+
+    setUpVDPScene(*emulator.vdp);
+}
+
+/**
+ * The same as Emulator::emulateFrame, but with the 68k replaced by a vertical scroll and a colour change at the start
+ * of each frame. Everything the writes depend on is in the save state.
+ *
+ * @param videoChecksum - Of the framebuffer after the last frame
+ * @param audioChecksum - Of every sample the sound chips made
+ */
+void Benchmark::runSaveStateFrames(Emulator &emulator, uint64_t frames, uint32_t &videoChecksum,
+                                   uint32_t &audioChecksum) {
+    audioChecksum = 2166136261u;
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        uint64_t frameEndTime = emulator.frameStartTime + emulator.masterClockRate;
+        uint64_t framesEmulated = emulator.framesEmulated;
+
+        emulator.m68kMasterClock = emulator.frameStartTime;
+        emulator.vdp->writeControl(0x4000);
+        emulator.vdp->writeControl(0x0010);
+        emulator.vdp->writeData(framesEmulated & 0x3FF);
+        emulator.vdp->writeControl(0xC002);
+        emulator.vdp->writeControl(0x0000);
+        emulator.vdp->writeData((framesEmulated * 0x246) & 0x0EEE);
+
+        while (emulator.scheduler->getMasterClock() < frameEndTime) {
+            uint64_t sliceEndTime = std::min(emulator.scheduler->getNextEventTime(), frameEndTime);
+            emulator.m68kMasterClock = sliceEndTime;
+            emulator.ym2612->setAccessClock(&emulator.z80MasterClock);
+            emulator.psg->setAccessClock(&emulator.z80MasterClock);
+
+            if (emulator.z80MasterClock < sliceEndTime) {
+                emulator.z80->run((int)((sliceEndTime - emulator.z80MasterClock + Z80_CLOCK_DIVIDER - 1) / Z80_CLOCK_DIVIDER));
+            }
+
+            emulator.scheduler->advanceTo(sliceEndTime);
+            emulator.handleEvents();
+        }
+
+        emulator.vdp->catchUp(frameEndTime);
+        emulator.ym2612->catchUp(frameEndTime);
+        emulator.psg->catchUp(frameEndTime);
+
+        for (int16_t sample : emulator.ym2612->getOutput()) {
+            audioChecksum = (audioChecksum ^ (uint16_t)sample) * 16777619u;
+        }
+
+        for (int16_t sample : emulator.psg->getOutput()) {
+            audioChecksum = (audioChecksum ^ (uint16_t)sample) * 16777619u;
+        }
+
+        emulator.ym2612->clearOutput();
+        emulator.psg->clearOutput();
+        emulator.frameStartTime = frameEndTime;
+        emulator.framesEmulated++;
+    }
+
+    videoChecksum = getFramebufferChecksum(*emulator.vdp);
+}
+
+/**
+ * Plays a VGM file through a YM2612 and PSG with a writer attached, recording what they are sent
+ */
+void Benchmark::replayVGM(const std::string &fileName, const std::string &replayedFileName) {
+    auto *player = new VGMPlayer(fileName);
+    auto *ym2612 = new YM2612();
+    auto *psg = new SN76489();
+    auto *writer = new VGMWriter(replayedFileName, 0);
+    uint64_t sample = 0;
+    bool playing = true;
+
+    // Only the writes are wanted
+    ym2612->setTimingOnly(true);
+    psg->setTimingOnly(true);
+    ym2612->setVGMWriter(writer);
+    psg->setVGMWriter(writer);
+
+    while (playing) {
+        sample += VGM_NTSC_FRAME_SAMPLES;
+        playing = player->run(*ym2612, *psg, sample);
+        writer->commit(player->getMasterClock());
+    }
+
+    writer->close(player->getMasterClock());
+    delete writer;
+    delete player;
+    delete ym2612;
+    delete psg;
+}
+
+/**
+ * Goes through a file from VGMWriter and checks that no two DAC writes share a sample, and neither do any two of the
+ * PSG writes standing in for the 68k's in the Z80 sound benchmark
+ *
+ * @return false if any do, or the file has a command VGMWriter wouldn't write
+ */
+bool Benchmark::checkVGMSpacing(const std::vector<unsigned char> &file, uint64_t &dacWrites, uint64_t &m68kWrites) {
+    size_t position = VGM_HEADER_SIZE;
+    uint64_t sample = 0;
+    uint64_t lastDACSample = UINT64_MAX;
+    uint64_t lastM68kSample = UINT64_MAX;
+    bool spaced = true;
+    dacWrites = 0;
+    m68kWrites = 0;
+
+    while (position < file.size() && file[position] != 0x66) {
+        unsigned char command = file[position];
+
+        if (command == 0x50 && (file[position + 1] & 0xF0) == Z80_SOUND_BENCHMARK_M68K_PSG_LATCH) {
+            spaced = spaced && sample != lastM68kSample;
+            lastM68kSample = sample;
+            m68kWrites++;
+        } else if (command == 0x52 && file[position + 1] == 0x2A) {
+            spaced = spaced && sample != lastDACSample;
+            lastDACSample = sample;
+            dacWrites++;
+        }
+
+        if (command == 0x50) {
+            position += 2;
+        } else if (command == 0x52 || command == 0x53) {
+            position += 3;
+        } else if (command == 0x61) {
+            sample += file[position + 1] | (file[position + 2] << 8);
+            position += 3;
+        } else if (command == 0x62 || command == 0x63) {
+            sample += command == 0x62 ? VGM_NTSC_FRAME_SAMPLES : VGM_PAL_FRAME_SAMPLES;
+            position++;
+        } else if (command >= 0x70 && command <= 0x7F) {
+            sample += (command & 0x0F) + 1;
+            position++;
+        } else {
+            return false;
+        }
+    }
+
+    return spaced;
+}
+
+std::vector<unsigned char> Benchmark::readFile(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+/**
+ * Plays a VGM file through the YM2612, PSG and resampler alone, as fast as they will go
+ *
+ * @param wavFileName - Where to write the output, nothing is written if empty
+ */
+void Benchmark::runVGM(const std::string &fileName, const std::string &wavFileName) {
+    auto *player = new VGMPlayer(fileName);
+    auto *ym2612 = new YM2612();
+    auto *psg = new SN76489();
+    auto *resampler = new AudioResampler(EMULATOR_AUDIO_RATE);
+    AudioRingBuffer *ringBuffer = nullptr;
+    AudioFileWriter *writer = nullptr;
+    std::vector<int16_t> output;
+    uint64_t sample = 0;
+    uint64_t outputFrames = 0;
+    uint32_t checksum = 2166136261u;
+    bool playing = true;
+
+    if (!wavFileName.empty()) {
+        ringBuffer = new AudioRingBuffer(EMULATOR_AUDIO_BUFFER_FRAMES);
+        writer = new AudioFileWriter(wavFileName, ringBuffer, EMULATOR_AUDIO_RATE);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // A frame's worth at a time, as the emulator would
+    while (playing) {
+        sample += VGM_NTSC_FRAME_SAMPLES;
+        playing = player->run(*ym2612, *psg, sample);
+        ym2612->catchUp(player->getMasterClock());
+        psg->catchUp(player->getMasterClock());
+
+        const std::vector<int16_t> &ym2612Output = ym2612->getOutput();
+        const std::vector<int16_t> &psgOutput = psg->getOutput();
+        resampler->process(ym2612Output.data(), psgOutput.data(), std::min(ym2612Output.size() / 2, psgOutput.size()), output);
+        ym2612->clearOutput();
+        psg->clearOutput();
+
+        for (int16_t value : output) {
+            checksum = (checksum ^ (uint16_t)value) * 16777619u;
+        }
+
+        // Unlike the emulator this waits for room rather than dropping anything, the writer is normally well ahead
+        size_t frames = output.size() / AUDIO_CHANNELS;
+        size_t written = 0;
+
+        while (ringBuffer != nullptr && written < frames) {
+            written += ringBuffer->write(&output[written * AUDIO_CHANNELS], frames - written);
+
+            if (written < frames) {
+                std::this_thread::yield();
+            }
+        }
+
+        outputFrames += frames;
+        output.clear();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double duration = (double)player->getMasterClock() / MASTER_CLOCK_RATE;
+
+    // Waits for the last of the output to be written
+    delete writer;
+    delete ringBuffer;
+
+    std::cout << "VGM: " << fileName << " (" << duration << " seconds)" << std::endl <<
+              "YM2612: " << YM2612::getImplementationName() << ", resampler: " <<
+              AudioResampler::getImplementationName() << std::endl <<
+              "Chip samples per second: " << (uint64_t)(ym2612->getSamplesGenerated() / seconds) << std::endl <<
+              "Output samples per second: " << (uint64_t)(outputFrames / seconds) << " (" << EMULATOR_AUDIO_RATE <<
+              "Hz)" << std::endl <<
+              "Real time factor: " << duration / seconds << "x" << std::endl <<
+              "Output checksum: " << std::hex << checksum << std::dec << std::endl;
+
+    if (!wavFileName.empty()) {
+        std::cout << "Written to " << wavFileName << std::endl;
+    }
+
+    delete player;
+    delete ym2612;
+    delete psg;
+    delete resampler;
+}
+
+/**
+ * Fills VRAM, CRAM and VSRAM with pseudo random data through the VDP ports, as a game would
+ */
+void Benchmark::setUpVDPScene(VDP &vdp) {
+    uint32_t seed = 12345;
+
+    // H40, display on, plane A at 0xC000, window at 0xB000, plane B at 0xE000, sprites at 0xF800,
+    // horizontal scroll at 0xFC00 (per line), vertical scroll per 16 pixel column, 64x32 planes, window over the bottom 2 rows
+    const uint16_t registerWrites[] = {
+            0x8004, 0x8144, 0x8230, 0x832C, 0x8407, 0x857C, 0x8700, 0x8B07,
+            0x8C81, 0x8D3F, 0x8F02, 0x9001, 0x9100, 0x929A
+    };
+
+    for (uint16_t registerWrite : registerWrites) {
+        vdp.writeControl(registerWrite);
+    }
+
+    // Tiles 0 - 1407 (0x0000 - 0xAFFF)
+    vdp.writeControl(0x4000);
+    vdp.writeControl(0x0000);
+
+    for (int i = 0; i < 0xB000; i += 2) {
+        vdp.writeData(nextRandom(seed) & 0xFFFF);
+    }
+
+    // Window, plane A and plane B name tables
+    const uint16_t nameTables[] = {0xB000, 0xC000, 0xE000};
+
+    for (uint16_t nameTable : nameTables) {
+        vdp.writeControl(0x4000 | (nameTable & 0x3FFF));
+        vdp.writeControl(nameTable >> 14);
+
+        for (int i = 0; i < 64 * 32; i++) {
+            uint32_t random = nextRandom(seed);
+            vdp.writeData((random & 0xF800) | ((random >> 16) % 1408));
+        }
+    }
+
+    // 80 sprites linked in order
+    vdp.writeControl(0x4000 | (0xF800 & 0x3FFF));
+    vdp.writeControl(0xF800 >> 14);
+
+    for (int i = 0; i < 80; i++) {
+        uint32_t random = nextRandom(seed);
+        vdp.writeData(128 + (random % 240));
+        vdp.writeData((((random >> 8) & 0x0F) << 8) | (i == 79 ? 0 : i + 1));
+        vdp.writeData(((random >> 12) & 0xF800) | ((random >> 16) % 1392));
+        vdp.writeData(96 + (nextRandom(seed) % 352));
+    }
+
+    // Horizontal scroll for each line
+    vdp.writeControl(0x4000 | (0xFC00 & 0x3FFF));
+    vdp.writeControl(0xFC00 >> 14);
+
+    for (int i = 0; i < VDP_SCREEN_HEIGHT * 2; i++) {
+        vdp.writeData(nextRandom(seed) & 0x3FF);
+    }
+
+    vdp.writeControl(0xC000);
+    vdp.writeControl(0x0000);
+
+    for (int i = 0; i < VDP_CRAM_SIZE; i++) {
+        vdp.writeData(nextRandom(seed) & 0x0EEE);
+    }
+
+    vdp.writeControl(0x4000);
+    vdp.writeControl(0x0010);
+
+    for (int i = 0; i < VDP_VSRAM_SIZE; i++) {
+        vdp.writeData(nextRandom(seed) & 0x3FF);
+    }
+}
+
+uint32_t Benchmark::nextRandom(uint32_t &seed) {
+    seed = seed * 1103515245 + 12345;
+    return seed ^ (seed >> 16);
+}
@@ -0,0 +1,70 @@
+#ifndef MEGANOSTALGIA_BENCHMARK_H
+#define MEGANOSTALGIA_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "VDP.h"
+#include "YM2612.h"
+#include "SN76489.h"
+#include "AudioResampler.h"
+#include "Emulator.h"
+
+/**
+ * Synthetic workloads for measuring the speed of individual components without needing a ROM
+ */
+class Benchmark {
+public:
+    static void runVDP(uint64_t lines);
+
+    static void runCompositor(uint64_t lines);
+
+    static void runDMA(uint64_t transfers);
+
+    static void runYM2612(uint64_t samples);
+
+    static void runPSG(uint64_t samples);
+
+    static void runResampler(uint64_t frames);
+
+    static void runAudioTiming(uint64_t frames);
+
+    static void runZ80Sound(uint64_t frames);
+
+    static void runSaveState(uint64_t frames);
+
+    static void runVGM(const std::string &fileName, const std::string &wavFileName);
+
+private:
+    static void setUpVDPScene(VDP &vdp);
+
+    static uint32_t getFramebufferChecksum(VDP &vdp);
+
+    static double timeCompositor(bool scalar, bool shadowHighlight, uint64_t lines, unsigned char *layers, unsigned char *output);
+
+    static double timeYM2612(bool vectorised, uint64_t samples, std::vector<int16_t> &output);
+
+    static void setUpYM2612Scene(YM2612 &ym2612);
+
+    static void writeYM2612Register(YM2612 &ym2612, int part, int reg, unsigned char value);
+
+    static double timeResampler(bool vectorised, uint64_t frames, const std::vector<int16_t> &ym2612,
+                                const std::vector<int16_t> &psg, std::vector<int16_t> &output);
+
+    static double timeAudioTiming(bool timingOnly, uint64_t frames, uint32_t &checksum);
+
+    static void setUpSaveStateEmulator(Emulator &emulator);
+
+    static void runSaveStateFrames(Emulator &emulator, uint64_t frames, uint32_t &videoChecksum,
+                                   uint32_t &audioChecksum);
+
+    static void replayVGM(const std::string &fileName, const std::string &replayedFileName);
+
+    static bool checkVGMSpacing(const std::vector<unsigned char> &file, uint64_t &dacWrites, uint64_t &m68kWrites);
+
+    static std::vector<unsigned char> readFile(const std::string &fileName);
+
+    static uint32_t nextRandom(uint32_t &seed);
+};
+
+#endif //MEGANOSTALGIA_BENCHMARK_H
@@ -36,6 +36,30 @@ void CPUM68k::reset() {
     enterSupervisorMode();
 }
 
+void CPUM68k::getSaveStateData(M68kSaveStateData &data) {
+    data.programCounter = programCounter;
+    data.supervisorStackPointer = supervisorStackPointer;
+    data.userStackPointer = userStackPointer;
+    data.statusRegister = statusRegister;
+
+    for (int i = 0; i < 8; i++) {
+        data.gpRegisters[i] = gpRegisters[i];
+        data.addressRegisters[i] = addressRegisters[i];
+    }
+}
+
+void CPUM68k::restoreState(const M68kSaveStateData &data) {
+    programCounter = data.programCounter;
+    supervisorStackPointer = data.supervisorStackPointer;
+    userStackPointer = data.userStackPointer;
+    statusRegister = data.statusRegister;
+
+    for (int i = 0; i < 8; i++) {
+        gpRegisters[i] = data.gpRegisters[i];
+        addressRegisters[i] = data.addressRegisters[i];
+    }
+}
+
 int CPUM68k::execute() {
     cyclesTaken = 0;
 
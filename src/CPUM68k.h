@@ -5,6 +5,7 @@
 #ifndef MEGANOSTALGIA_CPUM68K_H
 #define MEGANOSTALGIA_CPUM68K_H
 
+#include <type_traits>
 #include "Memory.h"
 
 enum M68KVectors {
@@ -81,6 +82,20 @@ struct M68KSystemFlags {
     int T;
 };
 
+/**
+ * Everything needed to restore the 68k to an exact point in time, kept as plain data so that it can be memcpy'd
+ */
+struct M68kSaveStateData {
+    uint32_t programCounter;
+    uint32_t supervisorStackPointer;
+    uint32_t userStackPointer;
+    uint32_t gpRegisters[8];
+    uint32_t addressRegisters[8];
+    unsigned short statusRegister;
+};
+
+static_assert(std::is_trivially_copyable<M68kSaveStateData>::value, "M68kSaveStateData must be trivially copyable");
+
 class CPUM68k {
 public:
     CPUM68k(Memory *memory);
@@ -89,6 +104,10 @@ public:
 
     void reset();
 
+    void getSaveStateData(M68kSaveStateData &data);
+
+    void restoreState(const M68kSaveStateData &data);
+
     static unsigned short parseInstructionMask(std::string mask);
 private:
 
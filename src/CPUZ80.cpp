@@ -3,13 +3,12 @@
 #include "CPUZ80.h"
 #include "Utils.h"
 #include "Exceptions.h"
+#include "Scheduler.h"
 
 CPUZ80::CPUZ80(Memory *smsMemory) {
     // Store a pointer to the memory object
     memory = smsMemory;
 
-    pauseInterruptWaiting = false;
-
     initialiseOpcodeHandlerPointers();
 
     cyclesTaken = 0;
@@ -24,11 +23,11 @@ CPUZ80::~CPUZ80() {
 
 void CPUZ80::reset() {
 
-    pauseInterruptWaiting = false;
     originalProgramCounterValue = programCounter = 0x0;
     stackPointer = 0xDFF0;
-    iff1 = iff2 = true;
-    enableInterrupts = false;
+    iff1 = iff2 = false;
+    eiEndCycle = -1;
+    irqLine = false;
     interruptMode = 0;
 
     for (auto & gpRegister : gpRegisters) {
@@ -58,6 +57,174 @@ int CPUZ80::execute() {
     return 0;
 }
 
+/**
+ * Executes instructions until the given number of cycles have passed, i.e. until the next scheduler deadline
+ * @param cycles - Number of cycles until the deadline
+ * @return - The number of cycles actually executed, this may overshoot the deadline by part of an instruction
+ */
+int CPUZ80::run(int cycles) {
+    cycleBudget = cycles;
+    cyclesExecuted = 0;
+    uint64_t startClock = masterClock != nullptr ? *masterClock : 0;
+
+    idleLoopTracking = false;
+
+    while (cyclesExecuted < cycleBudget && (state == CPUState::Running || state == CPUState::Halt)) {
+        sliceEnd = cycleBudget;
+
+        checkInterrupts();
+
+        if (state == CPUState::Halt || idleLoopDetected) {
+            fastForward();
+            continue;
+        }
+
+        while (cyclesExecuted < sliceEnd) {
+            if (masterClock != nullptr) {
+                *masterClock = startClock + (uint64_t)cyclesExecuted * Z80_CLOCK_DIVIDER;
+            }
+
+            cyclesExecuted += executeOpcode();
+        }
+    }
+
+    int result = cyclesExecuted;
+
+    if (masterClock != nullptr) {
+        *masterClock = startClock + (uint64_t)cyclesExecuted * Z80_CLOCK_DIVIDER;
+    }
+
+    // An EI which was the last instruction of this run still delays interrupts at the start of the next one
+    eiEndCycle = eiEndCycle == cyclesExecuted ? 0 : -1;
+
+    // Block instructions must not be run in bulk when single stepping through execute()
+    cycleBudget = cyclesExecuted = sliceEnd = 0;
+
+    return result;
+}
+
+/**
+ * @param masterClock - Clock which run() moves along as the Z80 executes, it is left at the end of the last instruction
+ */
+void CPUZ80::setMasterClock(uint64_t *masterClock) {
+    this->masterClock = masterClock;
+}
+
+/**
+ * Makes run() stop at the end of the current instruction so that interrupts are checked again
+ */
+void CPUZ80::endSlice() {
+    sliceEnd = 0;
+}
+
+/**
+ * Called by run() between slices, accepts a maskable interrupt if the /INT line is asserted and interrupts are enabled
+ */
+void CPUZ80::checkInterrupts() {
+    if (!irqLine || !iff1) {
+        return;
+    }
+
+    if (eiEndCycle == cyclesExecuted) {
+        // The instruction following EI is always executed before an interrupt is accepted
+        sliceEnd = cyclesExecuted + 1;
+        return;
+    }
+
+    acceptInterrupt();
+}
+
+/**
+ * Skips straight to the end of the current run() while halted or spinning in an idle loop, as nothing can change
+ * until the next scheduler event.
+ */
+void CPUZ80::fastForward() {
+    int remainingCycles = cycleBudget - cyclesExecuted;
+
+    if (state == CPUState::Halt) {
+        // Halt executes NOPs (4 cycles each) until an interrupt is accepted
+        int skippedCycles = ((remainingCycles + 3) / 4) * 4;
+        cyclesExecuted += skippedCycles;
+        haltCyclesSkipped += skippedCycles;
+        return;
+    }
+
+    idleLoopDetected = false;
+
+    int iterations = (remainingCycles + idleLoopCycles - 1) / idleLoopCycles;
+    cyclesExecuted += iterations * idleLoopCycles;
+    idleLoopCyclesSkipped += iterations * idleLoopCycles;
+    registerR = (registerR + iterations * idleLoopRegisterRIncrement) & 0x7F;
+}
+
+/**
+ * Called when a branch has been taken, checks whether the last iteration of a short backwards loop has left the CPU
+ * in exactly the same state as it started in.
+ */
+void CPUZ80::detectIdleLoop() {
+    if (programCounter > originalProgramCounterValue || originalProgramCounterValue - programCounter > 16 || sliceEnd == 0) {
+        return;
+    }
+
+    if (idleLoopTracking && programCounter == idleLoopTarget && stackPointer == idleLoopStackPointer && memoryWriteCount == idleLoopWriteCount &&
+        deviceReadCount == idleLoopDeviceReadCount) {
+        bool registersMatch = true;
+
+        for (int i = 0; i < 11; i++) {
+            registersMatch = registersMatch && gpRegisters[i].whole == idleLoopRegisters[i].whole;
+        }
+
+        if (registersMatch) {
+            idleLoopCycles = cyclesExecuted + cyclesTaken - idleLoopStartCycle;
+            idleLoopRegisterRIncrement = (registerR - idleLoopRegisterR) & 0x7F;
+            idleLoopDetected = true;
+            idleLoopTracking = false;
+            endSlice();
+            return;
+        }
+    }
+
+    // Take a snapshot at the top of the loop to compare against after the next iteration
+    idleLoopTracking = true;
+    idleLoopTarget = programCounter;
+    idleLoopStackPointer = stackPointer;
+    idleLoopWriteCount = memoryWriteCount;
+    idleLoopDeviceReadCount = deviceReadCount;
+    idleLoopRegisterR = registerR;
+    idleLoopStartCycle = cyclesExecuted + cyclesTaken;
+
+    for (int i = 0; i < 11; i++) {
+        idleLoopRegisters[i] = gpRegisters[i];
+    }
+}
+
+void CPUZ80::acceptInterrupt() {
+    idleLoopTracking = false;
+    state = CPUState::Running;
+    iff1 = iff2 = false;
+    registerR = (registerR + 1) & 0x7F;
+    pushStack(programCounter);
+
+    switch (interruptMode) {
+        case 2:
+            // Nothing drives the data bus during the acknowledge cycle on the Mega Drive, so the vector is read from (I << 8) | 0xFF
+            programCounter = readMemory16Bit((unsigned short)((registerI << 8) | 0xFF));
+            cyclesExecuted += 19;
+            break;
+        default:
+            // Mode 0 executes whatever is on the data bus, which will be 0xFF (rst 38h). Mode 1 always jumps to 0x38.
+            programCounter = 0x38;
+            cyclesExecuted += 13;
+            break;
+    }
+
+    gpRegisters[Z80Registers::WZ].whole = programCounter;
+}
+
+void CPUZ80::setIRQLine(bool asserted) {
+    irqLine = asserted;
+}
+
 int CPUZ80::executeOpcode() {
 
     cyclesTaken = 0;
@@ -73,27 +240,6 @@ int CPUZ80::executeOpcode() {
         originalRegisterValues[i] = gpRegisters[i];
     }
 
-    if (enableInterrupts) {
-        iff1 = iff2 = true;
-        enableInterrupts = false;
-    }
-
-    if (pauseInterruptWaiting) {
-        pauseInterruptWaiting = false;
-        pushStack(programCounter);
-        state = CPUState::Running;
-        programCounter = 0x66;
-        gpRegisters[Z80Registers::WZ].whole = programCounter;
-    }
-
-    if (false && iff1 && interruptMode == 1) {
-        state = CPUState::Running;
-        pushStack(programCounter);
-        programCounter = 0x38;
-        gpRegisters[Z80Registers::WZ].whole = programCounter;
-        iff1 = iff2 = false;
-    }
-
     if (state == CPUState::Halt) {
         return 4; // TODO not sure what to return here in terms of cycles taken, look into it - assume 4 for now
     }
@@ -154,6 +300,8 @@ unsigned short CPUZ80::getIndexedOffsetAddress(unsigned short registerValue) {
 void CPUZ80::extendedOpcodes() {
 
     unsigned char opcode = NBHideFromTrace();
+    // The prefixed opcode is fetched with another M1 cycle, so R goes up again
+    registerR = (registerR + 1) & 0x7F;
     displayOpcode = opcode;
     displayOpcodePrefix = 0xED;
 
@@ -168,6 +316,8 @@ void CPUZ80::extendedOpcodes() {
 
 void CPUZ80::indexOpcodes(Z80Registers indexRegister) {
     unsigned char opcode = NBHideFromTrace();
+    // The prefixed opcode is fetched with another M1 cycle, so R goes up again
+    registerR = (registerR + 1) & 0x7F;
     displayOpcode = opcode;
 
     indexRegisterForCurrentOpcode = indexRegister;
@@ -184,11 +334,8 @@ void CPUZ80::indexOpcodes(Z80Registers indexRegister) {
  * [logCPUState Log the CPU's current state to the console]
  */
 void CPUZ80::logCPUState() {
-    std::cout << std::uppercase << Utils::padString(executedInstructionName, 15) << "BC="
-              << Utils::formatHexNumber(originalRegisterValues[Z80Registers::BC].whole) << " DE=" << Utils::formatHexNumber(originalRegisterValues[Z80Registers::DE].whole) << " HL="
-              << Utils::formatHexNumber(originalRegisterValues[Z80Registers::HL].whole) << " AF=" << Utils::formatHexNumber(originalRegisterValues[Z80Registers::AF].whole) << " IX="
-              << Utils::formatHexNumber(originalRegisterValues[Z80Registers::IX].whole) << " IY=" << Utils::formatHexNumber(originalRegisterValues[Z80Registers::IY].whole) << " SP="
-              << Utils::formatHexNumber(originalStackPointerValue) << " PC=" << Utils::formatHexNumber(originalProgramCounterValue) << std::endl;
+    char line[Z80_TRACE_LINE_MAX_LENGTH];
+    std::cout.write(line, (std::streamsize)formatCPUState(line, sizeof(line)));
 }
 
 void CPUZ80::setFlag(Z80CPUFlag flag, bool value) {
@@ -276,6 +423,8 @@ unsigned short CPUZ80::popStack16() {
 void CPUZ80::bitOpcodes() {
 
     unsigned char opcode = NBHideFromTrace();
+    // The prefixed opcode is fetched with another M1 cycle, so R goes up again
+    registerR = (registerR + 1) & 0x7F;
     displayOpcodePrefix = 0xCB;
     displayOpcode = opcode;
 
@@ -294,48 +443,59 @@ void CPUZ80::indexBitOpcodes(Z80Registers indexRegister) {
     indexedAddressForCurrentOpcode = gpRegisters[indexRegister].whole + signedNB();
     gpRegisters[Z80Registers::WZ].whole = indexedAddressForCurrentOpcode;
     unsigned char opcode = NBHideFromTrace();
+    // Only the CB of DD CB d op is an M1 cycle, the offset and opcode are plain reads
+    registerR = (registerR + 1) & 0x7F;
     displayOpcode = opcode;
 
     (this->*indexBitOpcodeHandlers[opcode])();
+
+#ifdef VERBOSE_MODE
+    if (executedInstructionName.empty()) {
+        executedInstructionName = getInstructionName(indexRegister == Z80Registers::IX ? 0xDD : 0xFD, 0xCB, opcode);
+    }
+#endif
 }
 
-void CPUZ80::raisePauseInterrupt() {
-    pauseInterruptWaiting = true;
+/**
+ * Fills the given structure with the current state of the CPU, only valid between calls to run()
+ */
+void CPUZ80::getSaveStateData(Z80SaveStateData &data) {
+
+    for (int i = 0; i < 11; i++) {
+        data.registers[i] = gpRegisters[i].whole;
+    }
+
+    data.programCounter = programCounter;
+    data.stackPointer = stackPointer;
+    data.registerI = registerI;
+    data.registerR = registerR;
+    data.interruptMode = interruptMode;
+    data.iff1 = iff1;
+    data.iff2 = iff2;
+    data.eiDelayPending = eiEndCycle == 0;
+    data.irqLine = irqLine;
+    data.state = state;
 }
 
-//Z80SaveStateData* CPUZ80::getSaveStateData() {
-//    auto *result = new Z80SaveStateData();
-//
-//    for (int i = 0; i < 11; i++) {
-//        result->registers[i] = gpRegisters[i].whole;
-//    }
-//
-//    result->registerI = registerI;
-//    result->registerR = registerR;
-//    result->programCounter = programCounter;
-//    result->stackPointer = stackPointer;
-//    result->iff1 = iff1;
-//    result->iff2 = iff2;
-//    result->enableInterrupts = enableInterrupts;
-//
-//    return result;
-//}
-//
-//void CPUZ80::restoreState(Z80SaveStateData *data) {
-//
-//    for (int i = 0; i < 11; i++) {
-//        gpRegisters[i].whole = data->registers[i];
-//    }
-//
-//    registerI = data->registerI;
-//    registerR = data->registerR;
-//    programCounter = data->programCounter;
-//    stackPointer = data->stackPointer;
-//    iff1 = data->iff1;
-//    iff2 = data->iff2;
-//    enableInterrupts = data->enableInterrupts;
-//
-//}
+void CPUZ80::restoreState(const Z80SaveStateData &data) {
+
+    for (int i = 0; i < 11; i++) {
+        gpRegisters[i].whole = data.registers[i];
+    }
+
+    programCounter = data.programCounter;
+    stackPointer = data.stackPointer;
+    registerI = data.registerI;
+    registerR = data.registerR;
+    interruptMode = data.interruptMode;
+    iff1 = data.iff1;
+    iff2 = data.iff2;
+    eiEndCycle = data.eiDelayPending ? 0 : -1;
+    irqLine = data.irqLine;
+    state = data.state;
+    idleLoopTracking = false;
+    idleLoopDetected = false;
+}
 
 void CPUZ80::initialiseOpcodeHandlerPointers() {
     standardOpcodeHandlers[0x00] = &CPUZ80::standardOpcodeHandler0x00;
@@ -2,10 +2,17 @@
 #define MEGANOSTALGIA_CPUZ80_H
 
 #include <bitset>
+#include <type_traits>
+#include <string_view>
 #include "Utils.h"
 
 #define DEBUG_VALUES
 
+// Trace output - instruction names are padded to 15 characters, followed by 8 registers ("BC=0000 ")
+#define Z80_TRACE_NAME_PADDING 15
+#define Z80_TRACE_NAME_MAX_LENGTH 20
+#define Z80_TRACE_LINE_MAX_LENGTH (Z80_TRACE_NAME_MAX_LENGTH + 8 * 8)
+
 
 enum CPUState {
     Halt, Running, Error, Step
@@ -59,6 +66,26 @@ union Z80CPURegister {
     };
 };
 
+/**
+ * Everything needed to restore the Z80 to an exact point in time. Kept as plain data so that snapshots of the whole
+ * machine can be taken and restored with a memcpy.
+ */
+struct Z80SaveStateData {
+    unsigned short registers[11];
+    unsigned short programCounter;
+    unsigned short stackPointer;
+    unsigned char registerI;
+    unsigned char registerR;
+    unsigned char interruptMode;
+    bool iff1;
+    bool iff2;
+    bool eiDelayPending;
+    bool irqLine;
+    CPUState state;
+};
+
+static_assert(std::is_trivially_copyable<Z80SaveStateData>::value, "Z80SaveStateData must be trivially copyable");
+
 class CPUZ80 {
 public:
     CPUZ80(Memory *memory);
@@ -69,15 +96,29 @@ public:
 
     int execute();
 
+    int run(int cycles);
+
+    void setMasterClock(uint64_t *masterClock);
+
     CPUState getState() {
         return this->state;
     }
 
-    void raisePauseInterrupt();
+    uint64_t getHaltCyclesSkipped() {
+        return haltCyclesSkipped;
+    }
+
+    uint64_t getIdleLoopCyclesSkipped() {
+        return idleLoopCyclesSkipped;
+    }
+
+    void setIRQLine(bool asserted);
+
+    size_t formatCPUState(char *buffer, size_t bufferSize);
 
-//    Z80SaveStateData* getSaveStateData();
+    void getSaveStateData(Z80SaveStateData &data);
 
-//    void restoreState(Z80SaveStateData *data);
+    void restoreState(const Z80SaveStateData &data);
 
 private:
     typedef void (CPUZ80::*OpcodeHandler) ();
@@ -95,15 +136,13 @@ private:
     unsigned short originalProgramCounterValue{};
     unsigned short stackPointer{};
 
-    bool pauseInterruptWaiting;
-
     Z80CPURegister gpRegisters[11]{};
     Z80CPURegister originalRegisterValues[11]{};
     unsigned short originalStackPointerValue{};
     CPUState state;
     unsigned char registerI{};
     unsigned char registerR{};
-    std::string executedInstructionName = "";
+    std::string_view executedInstructionName = "";
     unsigned short displayOpcodePrefix{};
     unsigned char displayOpcode{};
 
@@ -116,7 +155,12 @@ private:
     // Interrupt flip flops
     bool iff1{};
     bool iff2{};
-    bool enableInterrupts{};
+
+    // State of the /INT line, asserted and released by scheduler events
+    bool irqLine{};
+
+    // The run() cycle at which an EI instruction finished, interrupts can't be accepted until after the next instruction
+    int eiEndCycle{-1};
     bool bitUseMemory{};
 
     void initialiseOpcodeHandlerPointers();
@@ -134,6 +178,48 @@ private:
     Memory *memory;
     int cyclesTaken;
 
+    // Used by run() - lets block instructions know how far away the next scheduler deadline is
+    int cycleBudget{};
+    int cyclesExecuted{};
+
+    // Master clock time the Z80 has reached, kept up to date by run() as each instruction starts so anything it
+    // accesses (e.g. the sound chips) sees the time of the access rather than the start of the slice
+    uint64_t *masterClock{};
+
+    // run() only checks for interrupts between slices, anything which may allow one to be accepted ends the current slice.
+    // This is normally the next scheduler deadline.
+    int sliceEnd{};
+
+    void endSlice();
+
+    void checkInterrupts();
+
+    void acceptInterrupt();
+
+    // Idle loop detection - a short loop which ends an iteration with exactly the same registers, hasn't written
+    // anything and has only read Z80 RAM will keep doing so until something else changes, which can only happen at the
+    // next scheduler event. Reads from anything else (e.g. the YM2612 status) can change part way through a slice.
+    bool idleLoopTracking{};
+    bool idleLoopDetected{};
+    unsigned short idleLoopTarget{};
+    unsigned short idleLoopStackPointer{};
+    Z80CPURegister idleLoopRegisters[11]{};
+    unsigned char idleLoopRegisterR{};
+    unsigned int idleLoopWriteCount{};
+    int idleLoopStartCycle{};
+    int idleLoopCycles{};
+    unsigned char idleLoopRegisterRIncrement{};
+    unsigned int memoryWriteCount{};
+    unsigned int idleLoopDeviceReadCount{};
+    unsigned int deviceReadCount{};
+
+    uint64_t haltCyclesSkipped{};
+    uint64_t idleLoopCyclesSkipped{};
+
+    void detectIdleLoop();
+
+    void fastForward();
+
     unsigned char NB();
 
     unsigned char NBHideFromTrace();
@@ -291,6 +377,12 @@ private:
 
     void otir(bool increment);
 
+    unsigned int getBulkBlockIterations(unsigned int remainingIterations);
+
+    unsigned int getZ80RAMRun(unsigned short address, bool increment);
+
+    bool blockWriteOverlapsInstruction(unsigned short address, unsigned int count, bool increment);
+
     void retn();
 
     void reti();
@@ -335,21 +427,7 @@ private:
     }
 
     // Misc
-    std::string getInstructionName(unsigned short opcode, unsigned short extendedOpcode, unsigned short lastOpcode);
-
-    std::vector<std::string> getStandardInstructionNames();
-
-    std::vector<std::string> getBitInstructionNames();
-
-    std::vector<std::string> getIXInstructionNames();
-
-    std::vector<std::string> getIXBitInstructionNames();
-
-    std::vector<std::string> getMiscInstructionNames();
-
-    std::vector<std::string> getIYInstructionNames();
-
-    std::vector<std::string> getIYBitInstructionNames();
+    std::string_view getInstructionName(unsigned short opcode, unsigned short extendedOpcode, unsigned short lastOpcode);
 
     void portOut(unsigned char port, unsigned char value);
 
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 #include "Memory.h"
 #include "CPUZ80.h"
 #include "Utils.h"
@@ -226,6 +228,7 @@ void CPUZ80::jpCondition(JPCondition condition) {
     }
 
     programCounter = jumpLocation;
+    detectIdleLoop();
 }
 
 void CPUZ80::jrCondition(JPCondition condition) {
@@ -244,6 +247,8 @@ void CPUZ80::jrCondition(JPCondition condition) {
     #ifdef DEBUG_VALUES
     readValue = (unsigned char)offset;
     #endif
+
+    detectIdleLoop();
 }
 
 void CPUZ80::retCondition(JPCondition condition) {
@@ -261,6 +266,7 @@ void CPUZ80::jr() {
     programCounter += signedNB();
     gpRegisters[Z80Registers::WZ].whole = programCounter;
     cyclesTaken = 12;
+    detectIdleLoop();
 }
 
 /**
@@ -333,14 +339,33 @@ void CPUZ80::ini(bool increment) {
 
 void CPUZ80::inir(bool increment) {
 
+    unsigned int remaining = gpRegisters[Z80Registers::BC].hi == 0 ? 0x100 : gpRegisters[Z80Registers::BC].hi;
+    unsigned int bulkIterations = std::min(getBulkBlockIterations(remaining), getZ80RAMRun(gpRegisters[Z80Registers::HL].whole, increment));
+
+    if (bulkIterations > 0 && !blockWriteOverlapsInstruction(gpRegisters[Z80Registers::HL].whole, bulkIterations, increment)) {
+        unsigned char *destination = memory->getZ80RAMPointer(gpRegisters[Z80Registers::HL].whole);
+
+        for (unsigned int i = 0; i < bulkIterations; i++) {
+            *destination = portIn(gpRegisters[Z80Registers::BC].lo);
+            destination += increment ? 1 : -1;
+        }
+
+        gpRegisters[Z80Registers::HL].whole += increment ? bulkIterations : -bulkIterations;
+        gpRegisters[Z80Registers::BC].hi -= bulkIterations;
+        registerR = (registerR + 2 * bulkIterations) & 0x7F; // ED prefix and opcode fetches
+    } else {
+        bulkIterations = 0;
+    }
+
+    // The final iteration always runs normally so that the flags end up correct
     ini(increment);
 
-    if (gpRegisters[Z80Registers::BC].hi == 0) {
-        return;
+    if (gpRegisters[Z80Registers::BC].hi != 0) {
+        programCounter -= 2;
+        cyclesTaken = 21;
     }
 
-    programCounter -= 2;
-    cyclesTaken = 21;
+    cyclesTaken += bulkIterations * 21;
 }
 
 void CPUZ80::cpi(bool increment) {
@@ -372,19 +397,45 @@ void CPUZ80::cpi(bool increment) {
 }
 
 void CPUZ80::cpir(bool increment) {
-    cpi(increment);
 
-    if (gpRegisters[Z80Registers::BC].whole == 0) {
-        return;
+    unsigned int remaining = gpRegisters[Z80Registers::BC].whole == 0 ? 0x10000 : gpRegisters[Z80Registers::BC].whole;
+    unsigned int bulkIterations = std::min(getBulkBlockIterations(remaining), getZ80RAMRun(gpRegisters[Z80Registers::HL].whole, increment));
+
+    if (bulkIterations > 0) {
+        // Skip over every byte which does not match, the matching one (if any) is compared normally below
+        unsigned char *source = memory->getZ80RAMPointer(gpRegisters[Z80Registers::HL].whole);
+        unsigned char value = gpRegisters[Z80Registers::AF].hi;
+        unsigned int skipped = 0;
+
+        if (increment) {
+            auto *match = (unsigned char *)memchr(source, value, bulkIterations);
+            skipped = match == nullptr ? bulkIterations : (unsigned int)(match - source);
+        } else {
+            while (skipped < bulkIterations && *(source - skipped) != value) {
+                skipped++;
+            }
+        }
+
+        bulkIterations = skipped;
     }
 
-    if (getFlag(Z80CPUFlag::zero)) {
-        return;
+    if (bulkIterations > 0) {
+        gpRegisters[Z80Registers::HL].whole += increment ? bulkIterations : -bulkIterations;
+        gpRegisters[Z80Registers::BC].whole -= bulkIterations;
+        gpRegisters[Z80Registers::WZ].whole = programCounter - 1;
+        registerR = (registerR + 2 * bulkIterations) & 0x7F; // ED prefix and opcode fetches
+    }
+
+    // The final iteration always runs normally so that the flags end up correct
+    cpi(increment);
+
+    if (gpRegisters[Z80Registers::BC].whole != 0 && !getFlag(Z80CPUFlag::zero)) {
+        cyclesTaken = 21;
+        programCounter -= 2;
+        gpRegisters[Z80Registers::WZ].whole = programCounter + 1;
     }
 
-    cyclesTaken = 21;
-    programCounter -= 2;
-    gpRegisters[Z80Registers::WZ].whole = programCounter + 1;
+    cyclesTaken += bulkIterations * 21;
 }
 
 void CPUZ80::ldi(bool increment) {
@@ -408,15 +459,56 @@ void CPUZ80::ldi(bool increment) {
 
 void CPUZ80::ldir(bool increment) {
 
+    unsigned short source = gpRegisters[Z80Registers::HL].whole;
+    unsigned short destination = gpRegisters[Z80Registers::DE].whole;
+    unsigned int remaining = gpRegisters[Z80Registers::BC].whole == 0 ? 0x10000 : gpRegisters[Z80Registers::BC].whole;
+    unsigned int bulkIterations = std::min({getBulkBlockIterations(remaining), getZ80RAMRun(source, increment), getZ80RAMRun(destination, increment)});
+
+    if (bulkIterations > 0 && !blockWriteOverlapsInstruction(destination, bulkIterations, increment)) {
+        unsigned char *sourcePointer = memory->getZ80RAMPointer(source);
+        unsigned char *destinationPointer = memory->getZ80RAMPointer(destination);
+
+        // memmove only gives the same result as copying byte by byte when the destination does not trail the source
+        // within the block (LDIR is commonly used with DE = HL + 1 to fill memory)
+        bool canMove = increment ?
+                (destination <= source || destination >= source + bulkIterations) :
+                (destination >= source || destination + bulkIterations <= source);
+
+        if (canMove) {
+            if (increment) {
+                memmove(destinationPointer, sourcePointer, bulkIterations);
+            } else {
+                memmove(destinationPointer - bulkIterations + 1, sourcePointer - bulkIterations + 1, bulkIterations);
+            }
+        } else {
+            int step = increment ? 1 : -1;
+
+            for (unsigned int i = 0; i < bulkIterations; i++) {
+                *destinationPointer = *sourcePointer;
+                destinationPointer += step;
+                sourcePointer += step;
+            }
+        }
+
+        gpRegisters[Z80Registers::HL].whole += increment ? bulkIterations : -bulkIterations;
+        gpRegisters[Z80Registers::DE].whole += increment ? bulkIterations : -bulkIterations;
+        gpRegisters[Z80Registers::BC].whole -= bulkIterations;
+        gpRegisters[Z80Registers::WZ].whole = programCounter - 1;
+        registerR = (registerR + 2 * bulkIterations) & 0x7F; // ED prefix and opcode fetches
+    } else {
+        bulkIterations = 0;
+    }
+
+    // The final iteration always runs normally so that the flags end up correct
     ldi(increment);
 
-    if (gpRegisters[Z80Registers::BC].whole == 0) {
-        return;
+    if (gpRegisters[Z80Registers::BC].whole != 0) {
+        programCounter -= 2;
+        gpRegisters[Z80Registers::WZ].whole = programCounter + 1;
+        cyclesTaken = 21;
     }
 
-    programCounter -= 2;
-    gpRegisters[Z80Registers::WZ].whole = programCounter + 1;
-    cyclesTaken = 21;
+    cyclesTaken += bulkIterations * 21;
 }
 
 void CPUZ80::outi(bool increment) {
@@ -448,14 +540,76 @@ void CPUZ80::outi(bool increment) {
 
 void CPUZ80::otir(bool increment) {
 
+    unsigned int remaining = gpRegisters[Z80Registers::BC].hi == 0 ? 0x100 : gpRegisters[Z80Registers::BC].hi;
+    unsigned int bulkIterations = std::min(getBulkBlockIterations(remaining), getZ80RAMRun(gpRegisters[Z80Registers::HL].whole, increment));
+
+    if (bulkIterations > 0) {
+        unsigned char *source = memory->getZ80RAMPointer(gpRegisters[Z80Registers::HL].whole);
+
+        for (unsigned int i = 0; i < bulkIterations; i++) {
+            portOut(gpRegisters[Z80Registers::BC].lo, *source);
+            source += increment ? 1 : -1;
+        }
+
+        gpRegisters[Z80Registers::HL].whole += increment ? bulkIterations : -bulkIterations;
+        gpRegisters[Z80Registers::BC].hi -= bulkIterations;
+        registerR = (registerR + 2 * bulkIterations) & 0x7F; // ED prefix and opcode fetches
+    }
+
+    // The final iteration always runs normally so that the flags end up correct
     outi(increment);
 
-    if (gpRegisters[Z80Registers::BC].hi == 0) {
-        return;
+    if (gpRegisters[Z80Registers::BC].hi != 0) {
+        programCounter -= 2;
+        cyclesTaken = 21;
+    }
+
+    cyclesTaken += bulkIterations * 21;
+}
+
+/**
+ * Returns how many iterations of a repeating block instruction may be carried out in bulk before its final
+ * iteration. The final iteration is always run through the normal handler so that the flags and WZ are set exactly.
+ * @param remainingIterations - Number of iterations left until the instruction completes (including this one)
+ * @return - Zero when not running through run(), so single stepping behaves as it always has
+ */
+unsigned int CPUZ80::getBulkBlockIterations(unsigned int remainingIterations) {
+    int cyclesUntilDeadline = sliceEnd - cyclesExecuted;
+
+    if (cyclesUntilDeadline <= 0) {
+        return 0;
     }
 
-    programCounter -= 2;
-    cyclesTaken = 21;
+    // Each repeated iteration takes 21 cycles, stop at the first iteration which reaches the next scheduler deadline
+    auto iterationsBeforeDeadline = (unsigned int)((cyclesUntilDeadline + 20) / 21);
+
+    return std::min(iterationsBeforeDeadline, remainingIterations) - 1;
+}
+
+/**
+ * Returns how many bytes of plain Z80 RAM can be walked through from the given address before leaving it
+ * @param address - Starting address
+ * @param increment - Direction of travel
+ * @return - Zero if the address is not in Z80 RAM
+ */
+unsigned int CPUZ80::getZ80RAMRun(unsigned short address, bool increment) {
+    if (memory->getZ80RAMPointer(address) == nullptr) {
+        return 0;
+    }
+
+    return increment ? Z80_RAM_SIZE - address : address + 1;
+}
+
+/**
+ * Returns true if writing the given number of bytes would modify the block instruction currently being executed,
+ * which would need to be re-fetched between iterations.
+ */
+bool CPUZ80::blockWriteOverlapsInstruction(unsigned short address, unsigned int count, bool increment) {
+    unsigned int low = increment ? address : address - count + 1;
+    unsigned int high = low + count - 1;
+    unsigned int instructionAddress = (unsigned short)(programCounter - 2);
+
+    return instructionAddress + 1 >= low && instructionAddress <= high;
 }
 
 void CPUZ80::call(unsigned short location, bool conditionMet) {
@@ -744,6 +898,10 @@ void CPUZ80::retn() {
     programCounter = popStack16();
     iff1 = iff2;
     cyclesTaken = 14;
+
+    if (irqLine && iff1) {
+        endSlice();
+    }
 }
 
 void CPUZ80::reti() {
@@ -831,11 +989,12 @@ unsigned char CPUZ80::portIn(unsigned char port) {
 }
 
 void CPUZ80::portOut(unsigned char port, unsigned char value) {
-    return;
+    memoryWriteCount++;
 }
 
 void CPUZ80::writeMemory(unsigned short location, unsigned char value) {
     memory->z80Write(location, value);
+    memoryWriteCount++;
 
     #ifdef DEBUG_VALUES
     readValue = value;
@@ -845,6 +1004,7 @@ void CPUZ80::writeMemory(unsigned short location, unsigned char value) {
 
 void CPUZ80::writeMemory(unsigned short location, unsigned short value) {
     memory->z80Write(location, value);
+    memoryWriteCount++;
 
     #ifdef DEBUG_VALUES
     readValue = value;
@@ -855,6 +1015,12 @@ void CPUZ80::writeMemory(unsigned short location, unsigned short value) {
 unsigned char CPUZ80::readMemory(unsigned short location) {
     // TODO this wrapper function has been created for debugging purposes to get console output - refactor later.
     unsigned char value = memory->z80Read(location);
+
+    // Anything outside Z80 RAM may change by itself, so a loop reading it is never idle
+    if (location >= Z80_RAM_SIZE) {
+        deviceReadCount++;
+    }
+
     #ifdef DEBUG_VALUES
     readValue = value;
     memoryAddress = location;
@@ -865,6 +1031,11 @@ unsigned char CPUZ80::readMemory(unsigned short location) {
 unsigned short CPUZ80::readMemory16Bit(unsigned short location) {
     // TODO this wrapper function has been created for debugging purposes to get console output - refactor later.
     unsigned short value = memory->z80Read16Bit(location);
+
+    if (location >= Z80_RAM_SIZE - 1) {
+        deviceReadCount++;
+    }
+
     #ifdef DEBUG_VALUES
         readValue = value;
         memoryAddress = location;
@@ -745,6 +745,7 @@ void CPUZ80::standardOpcodeHandler0x76() {
     // halt
     state = CPUState::Halt;
     cyclesTaken = 4;
+    endSlice(); // Let run() skip ahead to the next interrupt
 }
 
 void CPUZ80::standardOpcodeHandler0x77() {
@@ -1206,6 +1207,7 @@ void CPUZ80::standardOpcodeHandler0xC3() {
     // jp nn
     jpImm();
     cyclesTaken = 10;
+    detectIdleLoop();
 }
 
 void CPUZ80::standardOpcodeHandler0xC4() {
@@ -1516,8 +1518,13 @@ void CPUZ80::standardOpcodeHandler0xFA() {
 
 void CPUZ80::standardOpcodeHandler0xFB() {
     // ei
-    enableInterrupts = true; // Interrupts should be re-enabled when executing the next instruction
+    iff1 = iff2 = true;
     cyclesTaken = 4;
+    eiEndCycle = cyclesExecuted + cyclesTaken; // Interrupts are accepted once the next instruction has executed
+
+    if (irqLine) {
+        endSlice();
+    }
 }
 
 void CPUZ80::standardOpcodeHandler0xFC() {
@@ -168,6 +168,14 @@ unsigned char Cartridge::read(unsigned long location) {
     return rom[location];
 }
 
+/**
+ * Returns a pointer directly into ROM so that it can be copied from in bulk (e.g. by DMA). ROM is mapped straight
+ * through, the same as read().
+ */
+const unsigned char *Cartridge::getROMPointer(uint32_t location) {
+    return &rom[location];
+}
+
 void Cartridge::write(uint32_t location, unsigned char value) {
     // TODO handle writing to SRAM
 }
\ No newline at end of file
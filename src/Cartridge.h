@@ -20,6 +20,8 @@ public:
 
     unsigned char read(unsigned long location);
 
+    const unsigned char *getROMPointer(uint32_t location);
+
     void write(uint32_t location, unsigned char value);
 
 private:
@@ -2,23 +2,71 @@
 // Created by Peter Savory on 05/10/2023.
 //
 
+#include <algorithm>
 #include "Emulator.h"
 #include "Exceptions.h"
 
 Emulator::Emulator() {
     cartridge = new Cartridge();
-    memory = new Memory(cartridge);
+    vdp = new VDP();
+    ym2612 = new YM2612();
+    psg = new SN76489();
+    resampler = new AudioResampler(EMULATOR_AUDIO_RATE);
+    memory = new Memory(cartridge, vdp, ym2612, psg);
+    vdp->setMemory(memory);
+    vdp->setAccessClock(&m68kMasterClock);
     m68k = new CPUM68k(memory);
     z80 = new CPUZ80(memory);
+    z80->setMasterClock(&z80MasterClock);
+    scheduler = new Scheduler();
 
     // TODO improve the system timings, this is rough for now to get things started.
     masterClockRate = getMasterClockCyclesPerFrame();
 
+    m68kMasterClock = 0;
+    z80MasterClock = 0;
+    frameStartTime = 0;
+    framesEmulated = 0;
+    slicesRun = 0;
+    audioSamplesOutput = 0;
+    audioTimingOnly = false;
+    audioBuffer = nullptr;
+    audioWriter = nullptr;
+    audioFramesDropped = 0;
+    vgmWriter = nullptr;
 }
+
+/**
+ * Finishes off any audio or VGM file being written
+ */
+Emulator::~Emulator() {
+    stopAudioFile();
+    stopVGMLog();
+    delete scheduler;
+    delete z80;
+    delete m68k;
+    delete memory;
+    delete resampler;
+    delete psg;
+    delete ym2612;
+    delete vdp;
+    delete cartridge;
+}
+
 void Emulator::init(const std::string &romFileName) {
     cartridge->loadROM(romFileName);
     m68k->reset();
     z80->reset(); // TODO turn the Z80 off when we are executing it, the program needs to turn it on itself
+    vdp->reset();
+    ym2612->reset();
+    psg->reset();
+    resampler->reset();
+
+    scheduler->reset();
+    m68kMasterClock = 0;
+    z80MasterClock = 0;
+    frameStartTime = 0;
+    scheduler->schedule(SchedulerEvent::VInt, VINT_LINE * MASTER_CYCLES_PER_LINE);
 }
 
 void Emulator::run() {
@@ -27,38 +75,231 @@ void Emulator::run() {
     }
 }
 
+/**
+ * Runs for a fixed number of frames, useful for headless/batch runs and profiling
+ */
+void Emulator::runFrames(uint64_t frames) {
+    for (uint64_t i = 0; i < frames; i++) {
+        emulateFrame();
+    }
+}
+
+/**
+ * Draws the screen on a separate thread while the next frame is emulated
+ */
+void Emulator::setRenderThreaded(bool threaded) {
+    vdp->setRenderThreaded(threaded);
+}
+
+/**
+ * Skips all sound synthesis, for running headless as fast as possible. The YM2612 timers and busy flag still behave
+ * exactly as they would otherwise, since games wait on them.
+ */
+void Emulator::setAudioTimingOnly(bool timingOnly) {
+    if (timingOnly == audioTimingOnly) {
+        return;
+    }
+
+    ym2612->setTimingOnly(timingOnly);
+    psg->setTimingOnly(timingOnly);
+    audioTimingOnly = timingOnly;
+
+    // Whatever the resampler was holding on to is from before the gap
+    resampler->reset();
+}
+
+/**
+ * Streams the audio to a file (WAV if the name ends in .wav, otherwise raw samples) from a separate thread
+ */
+void Emulator::startAudioFile(const std::string &fileName) {
+    stopAudioFile();
+    audioBuffer = new AudioRingBuffer(EMULATOR_AUDIO_BUFFER_FRAMES);
+    audioWriter = new AudioFileWriter(fileName, audioBuffer, resampler->getOutputRate());
+}
+
+/**
+ * Waits for everything so far to be written and closes the file
+ */
+void Emulator::stopAudioFile() {
+    if (audioWriter != nullptr) {
+        delete audioWriter;
+        delete audioBuffer;
+        audioWriter = nullptr;
+        audioBuffer = nullptr;
+    }
+}
+
+/**
+ * Records every sound chip write from now on, for playing back without the CPUs. Should be started straight after init
+ * since the file assumes the chips start from reset.
+ */
+void Emulator::startVGMLog(const std::string &fileName) {
+    stopVGMLog();
+    vgmWriter = new VGMWriter(fileName, scheduler->getMasterClock());
+    ym2612->setVGMWriter(vgmWriter);
+    psg->setVGMWriter(vgmWriter);
+}
+
+void Emulator::stopVGMLog() {
+    if (vgmWriter != nullptr) {
+        ym2612->setVGMWriter(nullptr);
+        psg->setVGMWriter(nullptr);
+        vgmWriter->close(scheduler->getMasterClock());
+        std::cout << "VGM commands written: " << vgmWriter->getCommandsWritten() << std::endl;
+        delete vgmWriter;
+        vgmWriter = nullptr;
+    }
+}
+
+void Emulator::printStats() {
+    std::cout << "Frames emulated: " << framesEmulated << std::endl <<
+              "Scheduler slices run: " << slicesRun << std::endl <<
+              "Z80 cycles skipped while halted: " << z80->getHaltCyclesSkipped() << std::endl <<
+              "Z80 cycles skipped in idle loops: " << z80->getIdleLoopCyclesSkipped() << std::endl <<
+              "VDP lines rendered: " << vdp->getLinesRendered() << std::endl <<
+              "VDP tiles decoded: " << vdp->getTilesDecoded() << std::endl <<
+              "VDP frames rendered: " << vdp->getFramesRendered() << std::endl <<
+              "VDP frames reused: " << vdp->getFramesReused() << std::endl <<
+              "YM2612 samples generated: " << ym2612->getSamplesGenerated() << std::endl <<
+              "PSG samples generated: " << psg->getSamplesGenerated() << std::endl <<
+              "PSG transitions: " << psg->getTransitions() << std::endl <<
+              "Audio samples output: " << audioSamplesOutput << " (" << resampler->getOutputRate() << "Hz, " <<
+              AudioResampler::getImplementationName() << ")" << std::endl <<
+              "Audio frames dropped: " << audioFramesDropped << std::endl;
+}
+
+/**
+ * Takes a snapshot of the whole machine, should only be called between frames
+ */
+void Emulator::saveState(EmulatorSaveStateData &data) {
+    m68k->getSaveStateData(data.m68k);
+    z80->getSaveStateData(data.z80);
+    memory->getSaveStateData(data.memory);
+    vdp->getSaveStateData(data.vdp);
+    ym2612->getSaveStateData(data.ym2612);
+    psg->getSaveStateData(data.psg);
+    scheduler->getSaveStateData(data.scheduler);
+    data.m68kMasterClock = m68kMasterClock;
+    data.z80MasterClock = z80MasterClock;
+    data.frameStartTime = frameStartTime;
+    data.framesEmulated = framesEmulated;
+}
+
+void Emulator::restoreState(const EmulatorSaveStateData &data) {
+    m68k->restoreState(data.m68k);
+    z80->restoreState(data.z80);
+    memory->restoreState(data.memory);
+    vdp->restoreState(data.vdp);
+    ym2612->restoreState(data.ym2612);
+    psg->restoreState(data.psg);
+    resampler->reset();
+    scheduler->restoreState(data.scheduler);
+    m68kMasterClock = data.m68kMasterClock;
+    z80MasterClock = data.z80MasterClock;
+    frameStartTime = data.frameStartTime;
+    framesEmulated = data.framesEmulated;
+}
+
 void Emulator::emulateFrame() {
-    // TODO handle proper console timing - this is all (probably incorrect) guesswork just to get things started.
-    uint32_t ticksThisUpdate = 0;
+    uint64_t frameEndTime = frameStartTime + masterClockRate;
 
-    while (ticksThisUpdate < masterClockRate) {
+    while (scheduler->getMasterClock() < frameEndTime) {
+        // Nothing that affects more than one component can happen until the next event, so run everything up to it
+        uint64_t sliceEndTime = std::min(scheduler->getNextEventTime(), frameEndTime);
 
-        // Update 68k
-        int m68kCycles = m68k->execute();
+        // Update 68k, which is frozen while the VDP is doing a DMA transfer from 68k memory
+        ym2612->setAccessClock(&m68kMasterClock);
+        psg->setAccessClock(&m68kMasterClock);
 
-        int machineClicks = m68kCycles * 7;
-        float neededZ80Cycles = (float)machineClicks / 15;
+        while (m68kMasterClock < sliceEndTime) {
+            m68kMasterClock += m68k->execute() * M68K_CLOCK_DIVIDER;
+            m68kMasterClock += vdp->takeM68kStallCycles();
+        }
 
-        // TODO update z80
-        float z80Cycles = 0;
+        // Update z80, any overshoot is carried over into the next slice
+        ym2612->setAccessClock(&z80MasterClock);
+        psg->setAccessClock(&z80MasterClock);
 
-        while (z80Cycles < neededZ80Cycles) {
-            break;
+        if (z80MasterClock < sliceEndTime) {
+            auto neededZ80Cycles = (int)((sliceEndTime - z80MasterClock + Z80_CLOCK_DIVIDER - 1) / Z80_CLOCK_DIVIDER);
+
+            // Moves z80MasterClock along instruction by instruction, so the sound chips see when each access happened
+            z80->run(neededZ80Cycles);
+        }
+
+        // Both CPUs have reached the end of the slice, so neither can write anything from before it
+        if (vgmWriter != nullptr) {
+            vgmWriter->commit(sliceEndTime);
         }
 
-        // TODO update VDP
-        float vdpCycles = (float)machineClicks / 4;
+        scheduler->advanceTo(sliceEndTime);
+        handleEvents();
+        slicesRun++;
+    }
 
-        // TODO update Sound
-        int fmCycles = m68kCycles;
-        float psgCycles = z80Cycles;
+    // Nothing may have touched the VDP or sound chips for a while, make sure the whole frame has been drawn and heard
+    vdp->catchUp(frameEndTime);
+    ym2612->catchUp(frameEndTime);
+    psg->catchUp(frameEndTime);
 
-        ticksThisUpdate += machineClicks;
+    if (!audioTimingOnly) {
+        outputAudio();
+    }
+
+    frameStartTime = frameEndTime;
+    framesEmulated++;
+}
+
+/**
+ * Mixes and resamples the frame's audio and passes it on to whatever is listening
+ */
+void Emulator::outputAudio() {
+    // Both chips make a sample at the same times, so there are always the same number of each
+    const std::vector<int16_t> &ym2612Output = ym2612->getOutput();
+    const std::vector<int16_t> &psgOutput = psg->getOutput();
+    size_t sampleCount = std::min(ym2612Output.size() / 2, psgOutput.size());
+    resampler->process(ym2612Output.data(), psgOutput.data(), sampleCount, audioOutput);
+    ym2612->clearOutput();
+    psg->clearOutput();
+
+    // The ring buffer never waits, if the consumer has fallen that far behind the audio is lost
+    size_t audioFrames = audioOutput.size() / AUDIO_CHANNELS;
+
+    if (audioBuffer != nullptr) {
+        audioFramesDropped += audioFrames - audioBuffer->write(audioOutput.data(), audioFrames);
+    }
+
+    audioSamplesOutput += audioFrames;
+    audioOutput.clear();
+}
+
+void Emulator::handleEvents() {
+    SchedulerEvent event;
+
+    while (scheduler->getDueEvent(event)) {
+        uint64_t now = scheduler->getMasterClock();
+
+        switch (event) {
+            case SchedulerEvent::VInt:
+                // Only the VDP flag and the Z80 are interrupted. The 68k core can't take interrupts, so the level 6
+                // interrupt that VDP register 1 can enable is never raised.
+                vdp->catchUp(now);
+                vdp->triggerVInt();
+                scheduler->schedule(SchedulerEvent::VInt, now + masterClockRate);
+                z80->setIRQLine(true);
+                scheduler->schedule(SchedulerEvent::Z80InterruptEnd, now + Z80_INTERRUPT_PULSE_LENGTH);
+                break;
+            case SchedulerEvent::Z80InterruptEnd:
+                z80->setIRQLine(false);
+                break;
+            default:
+                break;
+        }
     }
 }
 
 uint32_t Emulator::getMasterClockCyclesPerFrame() {
     // 896,040 (NTSC), 1,067,040 (PAL) - From https://segaretro.org/Sega_Mega_Drive/Technical_specifications
     // TODO handle PAL timings
-    return 896040;
-}
\ No newline at end of file
+    return MASTER_CYCLES_PER_LINE * LINES_PER_FRAME;
+}
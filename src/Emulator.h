@@ -6,10 +6,45 @@
 #define MEGANOSTALGIA_EMULATOR_H
 
 #include <iostream>
+#include <vector>
 #include "Cartridge.h"
 #include "Memory.h"
 #include "CPUM68k.h"
 #include "CPUZ80.h"
+#include "Scheduler.h"
+#include "VDP.h"
+#include "YM2612.h"
+#include "SN76489.h"
+#include "AudioResampler.h"
+#include "AudioRingBuffer.h"
+#include "AudioFileWriter.h"
+#include "VGMWriter.h"
+
+// Rate the mixed audio is resampled to for the host
+#define EMULATOR_AUDIO_RATE 48000
+
+// Frames of audio that can be waiting for the audio output, about 1.4 seconds
+#define EMULATOR_AUDIO_BUFFER_FRAMES 65536
+
+/**
+ * A snapshot of the whole machine. Every part of it is plain data, so snapshots can be copied around freely
+ * (e.g. kept in a ring buffer for rollback).
+ */
+struct EmulatorSaveStateData {
+    M68kSaveStateData m68k;
+    Z80SaveStateData z80;
+    MemorySaveStateData memory;
+    VDPSaveStateData vdp;
+    YM2612SaveStateData ym2612;
+    SN76489SaveStateData psg;
+    SchedulerSaveStateData scheduler;
+    uint64_t m68kMasterClock;
+    uint64_t z80MasterClock;
+    uint64_t frameStartTime;
+    uint64_t framesEmulated;
+};
+
+static_assert(std::is_trivially_copyable<EmulatorSaveStateData>::value, "EmulatorSaveStateData must be trivially copyable");
 
 class Emulator {
 public:
@@ -22,20 +57,73 @@ public:
 
     void run();
 
+    void runFrames(uint64_t frames);
+
+    void printStats();
+
+    void setRenderThreaded(bool threaded);
+
+    void setAudioTimingOnly(bool timingOnly);
+
+    void startAudioFile(const std::string &fileName);
+
+    void stopAudioFile();
+
+    void startVGMLog(const std::string &fileName);
+
+    void stopVGMLog();
+
+    void saveState(EmulatorSaveStateData &data);
+
+    void restoreState(const EmulatorSaveStateData &data);
+
 private:
 
+    // The save state benchmark runs frames without the 68k, which can't run code yet
+    friend class Benchmark;
+
     Cartridge *cartridge;
     Memory *memory;
     CPUZ80 *z80;
     CPUM68k *m68k;
+    Scheduler *scheduler;
+    VDP *vdp;
+    YM2612 *ym2612;
+    SN76489 *psg;
+    AudioResampler *resampler;
 
     void emulateFrame();
 
+    void outputAudio();
+
+    void handleEvents();
+
     uint32_t getMasterClockCyclesPerFrame();
 
     uint32_t masterClockRate;
     uint32_t m68kClockRatePerMachineTick;
     uint32_t z80ClockRatePerMachineTick;
+
+    // Master clock time that each CPU has been run up to
+    uint64_t m68kMasterClock;
+    uint64_t z80MasterClock;
+
+    uint64_t frameStartTime;
+
+    uint64_t framesEmulated;
+    uint64_t slicesRun;
+
+    // Mixed and resampled audio for the current frame, interleaved stereo
+    std::vector<int16_t> audioOutput;
+    uint64_t audioSamplesOutput;
+    bool audioTimingOnly;
+
+    // Where the audio goes, if anywhere
+    AudioRingBuffer *audioBuffer;
+    AudioFileWriter *audioWriter;
+    uint64_t audioFramesDropped;
+
+    VGMWriter *vgmWriter;
 };
 
 #endif //MEGANOSTALGIA_EMULATOR_H
@@ -2,11 +2,15 @@
 // Created by Peter Savory on 05/10/2023.
 //
 
+#include <cstring>
 #include "Memory.h"
 
-Memory::Memory(Cartridge *cartridge) {
+Memory::Memory(Cartridge *cartridge, VDP *vdp, YM2612 *ym2612, SN76489 *psg) {
 
     this->cartridge = cartridge;
+    this->vdp = vdp;
+    this->ym2612 = ym2612;
+    this->psg = psg;
     for (int i = 0; i < 0xFFFF; i++) {
         m68kRAM[i] = 0;
     }
@@ -28,24 +32,9 @@ unsigned char Memory::z80Read(uint16_t location) {
         return 0x0;
     }
 
-    if (location == 0x4000) {
-        // TODO YM2612 A0
-        return 0x0;
-    }
-
-    if (location == 0x4001) {
-        // TODO YM2612 D0
-        return 0x0;
-    }
-
-    if (location == 0x4002) {
-        // TODO YM2612 A1
-        return 0x0;
-    }
-
-    if (location == 0x4003) {
-        // TODO YM2612 D1
-        return 0x0;
+    if (location <= 0x4003) {
+        // 0x4000 - 0x4003 - YM2612, every port reads the status
+        return ym2612->readStatus();
     }
 
     if (location <= 0x5FFF) {
@@ -64,7 +53,7 @@ unsigned char Memory::z80Read(uint16_t location) {
     }
 
     if (location == 0x7F11) {
-        // TODO SN76489 PSG
+        // 0x7F11 - SN76489 PSG, write only
         return 0x0;
     }
 
@@ -94,23 +83,9 @@ void Memory::z80Write(uint16_t location, unsigned char value) {
         return;
     }
 
-    if (location == 0x4000) {
-        // TODO YM2612 A0
-        return;
-    }
-
-    if (location == 0x4001) {
-        // TODO YM2612 D0
-        return;
-    }
-
-    if (location == 0x4002) {
-        // TODO YM2612 A1
-        return;
-    }
-
-    if (location == 0x4003) {
-        // TODO YM2612 D1
+    if (location <= 0x4003) {
+        // 0x4000 - 0x4003 - YM2612 A0, D0, A1, D1
+        ym2612->write(location & 0x03, value);
         return;
     }
 
@@ -130,7 +105,8 @@ void Memory::z80Write(uint16_t location, unsigned char value) {
     }
 
     if (location == 0x7F11) {
-        // TODO SN76489 PSG
+        // 0x7F11 - SN76489 PSG
+        psg->write(value);
         return;
     }
 
@@ -147,6 +123,55 @@ void Memory::z80Write(uint16_t location, unsigned short value) {
     z80Write(location+1, (unsigned char)(value >> 8));
 }
 
+/**
+ * Returns a pointer directly into Z80 RAM so that block instructions can operate on it in bulk
+ * @param location - Z80 address
+ * @return - nullptr if the location is not plain RAM (i.e. accessing it may have side effects)
+ */
+unsigned char *Memory::getZ80RAMPointer(uint16_t location) {
+    if (location >= Z80_RAM_SIZE) {
+        return nullptr;
+    }
+
+    return &z80RAM[location];
+}
+
+/**
+ * Returns a pointer directly into cartridge ROM or 68k RAM so that DMA can copy from it in bulk
+ * @param location - 68k address
+ * @param length - Set to the number of bytes which can be read from the pointer
+ * @return - nullptr if the location is not plain ROM/RAM
+ */
+const unsigned char *Memory::getM68kReadPointer(uint32_t location, uint32_t &length) {
+    location &= 0xFFFFFF;
+
+    if (location <= 0x3FFFFF) {
+        // Only valid while the whole 4MB is mapped straight through to ROM, as it is with no mapper. Banked ranges will
+        // need to return nullptr (or stop at the end of the bank) once a mapper is added, so DMA reads them word by
+        // word through m68kRead16Bit instead.
+        length = 0x400000 - location;
+        return cartridge->getROMPointer(location);
+    }
+
+    if (location >= 0xFF0000) {
+        length = M68K_RAM_SIZE - (location & 0xFFFF);
+        return &m68kRAM[location & 0xFFFF];
+    }
+
+    length = 0;
+    return nullptr;
+}
+
+void Memory::getSaveStateData(MemorySaveStateData &data) {
+    memcpy(data.z80RAM, z80RAM, Z80_RAM_SIZE);
+    memcpy(data.m68kRAM, m68kRAM, M68K_RAM_SIZE);
+}
+
+void Memory::restoreState(const MemorySaveStateData &data) {
+    memcpy(z80RAM, data.z80RAM, Z80_RAM_SIZE);
+    memcpy(m68kRAM, data.m68kRAM, M68K_RAM_SIZE);
+}
+
 unsigned char Memory::m68kRead(uint32_t location) {
     // TODO simplify this function when I've determined which parts of memory are write only
     // TODO could also be refactored to be more performant, currently writing it to make the memory map easy to understand
@@ -339,34 +364,19 @@ unsigned char Memory::m68kRead(uint32_t location) {
         return 0x0;
     }
 
-    if (location <= 0xC00001) {
-        // 0xC00000 - 0xC00001: VDP data port
-        return 0x0;
-    }
-
-    if (location <= 0xC00003) {
-        // 0xC00002 - 0xC00003: VDP data port (mirror)
-        return 0x0;
-    }
-
-    if (location <= 0xC00005) {
-        // 0xC00004 - 0xC00005: VDP control port
-        return 0x0;
-    }
-
     if (location <= 0xC00007) {
-        // 0xC00006 - 0xC00007: VDP control port (mirror)
-        return 0x0;
-    }
-
-    if (location <= 0xC00009) {
-        // 0xC00008 - 0xC00009: VDP H/V counter
-        return 0x0;
+        // 0xC00000 - 0xC00003: VDP data port (and mirror)
+        // 0xC00004 - 0xC00007: VDP control port (and mirror)
+        // The VDP ports are 16 bits wide, byte reads return half of the word
+        uint16_t value = vdpRead(location);
+        return (location & 1) ? (unsigned char)(value & 0xFF) : (unsigned char)(value >> 8);
     }
 
     if (location <= 0xC0000F) {
+        // 0xC00008 - 0xC00009: VDP H/V counter, V counter in the high byte
         // 0xC0000A - 0xC0000F: VDP H/V counter (mirror)
-        return 0x0;
+        uint16_t value = vdpRead(location);
+        return (location & 1) ? (unsigned char)(value & 0xFF) : (unsigned char)(value >> 8);
     }
 
     if (location == 0xC00010) {
@@ -412,11 +422,15 @@ unsigned char Memory::m68kRead(uint32_t location) {
 }
 
 unsigned short Memory::m68kRead16Bit(uint32_t location) {
+    if (location >= 0xC00000 && location <= 0xC0000F) {
+        return vdpRead(location);
+    }
+
     return (m68kRead(location) << 8) + m68kRead(location+1);
 }
 
 uint32_t Memory::m68kRead32Bit(uint32_t location) {
-    return (m68kRead(location) << 24) + (m68kRead(location+1) << 16) + (m68kRead(location+2) << 8) + m68kRead(location + 3);
+    return (m68kRead16Bit(location) << 16) + m68kRead16Bit(location + 2);
 }
 
 void Memory::m68kWrite(uint32_t location, unsigned char value) {
@@ -613,23 +627,11 @@ void Memory::m68kWrite(uint32_t location, unsigned char value) {
         return;
     }
 
-    if (location <= 0xC00001) {
-        // 0xC00000 - 0xC00001: VDP data port
-        return;
-    }
-
-    if (location <= 0xC00003) {
-        // 0xC00002 - 0xC00003: VDP data port (mirror)
-        return;
-    }
-
-    if (location <= 0xC00005) {
-        // 0xC00004 - 0xC00005: VDP control port
-        return;
-    }
-
     if (location <= 0xC00007) {
-        // 0xC00006 - 0xC00007: VDP control port (mirror)
+        // 0xC00000 - 0xC00003: VDP data port (and mirror)
+        // 0xC00004 - 0xC00007: VDP control port (and mirror)
+        // Byte writes to the VDP put the same value on both halves of the bus
+        vdpWrite(location, (value << 8) | value);
         return;
     }
 
@@ -649,6 +651,7 @@ void Memory::m68kWrite(uint32_t location, unsigned char value) {
     }
     if (location == 0xC00011) {
         // 0xC00011 - PSG output
+        psg->write(value);
         return;
     }
 
@@ -658,7 +661,10 @@ void Memory::m68kWrite(uint32_t location, unsigned char value) {
     }
 
     if (location <= 0xC00017) {
-        // 0xC00013 - 0xC00017: PSG output (mirror)
+        // 0xC00013 - 0xC00017: PSG output (mirror on the odd addresses)
+        if (location & 1) {
+            psg->write(value);
+        }
         return;
     }
 
@@ -684,13 +690,42 @@ void Memory::m68kWrite(uint32_t location, unsigned char value) {
 }
 
 void Memory::m68kWrite(uint32_t location, unsigned short value) {
+    if (location >= 0xC00000 && location <= 0xC00007) {
+        vdpWrite(location, value);
+        return;
+    }
+
     m68kWrite(location, (unsigned char)(value >> 8));
     m68kWrite(location + 1, (unsigned char)(value & 0xFF));
 }
 
 void Memory::m68kWrite(uint32_t location, uint32_t value) {
-    m68kWrite(location, (unsigned char)(value >> 24));
-    m68kWrite(location + 1, (unsigned char)(value >> 16));
-    m68kWrite(location + 2, (unsigned char)(value >> 8));
-    m68kWrite(location + 3, (unsigned char)(value & 0xFF));
+    // Long writes happen as two word writes, the VDP relies on this for commands
+    m68kWrite(location, (unsigned short)(value >> 16));
+    m68kWrite(location + 2, (unsigned short)(value & 0xFFFF));
+}
+
+/**
+ * @param location - 0xC00000 - 0xC0000F, bit 3 selects the H/V counter and bit 2 the control port rather than the data
+ * port
+ */
+uint16_t Memory::vdpRead(uint32_t location) {
+    if (location & 0x08) {
+        return vdp->readHVCounter();
+    }
+
+    if (location & 0x04) {
+        return vdp->readControl();
+    }
+
+    return vdp->readData();
+}
+
+void Memory::vdpWrite(uint32_t location, uint16_t value) {
+    if (location & 0x04) {
+        vdp->writeControl(value);
+        return;
+    }
+
+    vdp->writeData(value);
 }
\ No newline at end of file
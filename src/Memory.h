@@ -6,12 +6,26 @@
 #define MEGANOSTALGIA_MEMORY_H
 
 #include <cstdint>
+#include <type_traits>
 #include "Cartridge.h"
+#include "VDP.h"
+#include "YM2612.h"
+#include "SN76489.h"
+
+#define Z80_RAM_SIZE 0x2000
+#define M68K_RAM_SIZE 0x10000
+
+struct MemorySaveStateData {
+    unsigned char z80RAM[Z80_RAM_SIZE];
+    unsigned char m68kRAM[M68K_RAM_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<MemorySaveStateData>::value, "MemorySaveStateData must be trivially copyable");
 
 class Memory {
 public:
 
-    Memory(Cartridge *cartridge);
+    Memory(Cartridge *cartridge, VDP *vdp, YM2612 *ym2612, SN76489 *psg);
 
     unsigned char z80Read(uint16_t location);
 
@@ -33,14 +47,31 @@ public:
 
     void z80Write(uint16_t location, unsigned short value);
 
+    unsigned char *getZ80RAMPointer(uint16_t location);
+
+    const unsigned char *getM68kReadPointer(uint32_t location, uint32_t &length);
+
+    void getSaveStateData(MemorySaveStateData &data);
+
+    void restoreState(const MemorySaveStateData &data);
 
 private:
 
-    unsigned char z80RAM[0x2000];
+    unsigned char z80RAM[Z80_RAM_SIZE];
 
-    unsigned char m68kRAM[0x10000];
+    unsigned char m68kRAM[M68K_RAM_SIZE];
 
     Cartridge *cartridge;
+
+    VDP *vdp;
+
+    YM2612 *ym2612;
+
+    SN76489 *psg;
+
+    uint16_t vdpRead(uint32_t location);
+
+    void vdpWrite(uint32_t location, uint16_t value);
 };
 
 #endif //MEGANOSTALGIA_MEMORY_H
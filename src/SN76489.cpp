@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <cstring>
+#include "SN76489.h"
+
+// Amplitude of a channel for each attenuation setting, 2dB steps with 15 being silent
+static const int volumeTable[16] = {
+        2048, 1627, 1292, 1026, 815, 648, 514, 409, 325, 258, 205, 163, 129, 103, 82, 0
+};
+
+#define SN76489_PI 3.14159265358979323846
+
+// Cutoff of the band-limited steps as a fraction of the sample rate, a little under half
+#define SN76489_BLEP_CUTOFF 0.45
+
+struct SN76489BlepKernel {
+    int32_t taps[SN76489_BLEP_PHASES][SN76489_BLEP_TAPS];
+};
+
+static constexpr double blepSin(double x) {
+    while (x > SN76489_PI) {
+        x -= 2 * SN76489_PI;
+    }
+
+    while (x < -SN76489_PI) {
+        x += 2 * SN76489_PI;
+    }
+
+    double term = x;
+    double result = x;
+
+    for (int n = 1; n < 20; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        result += term;
+    }
+
+    return result;
+}
+
+/**
+ * A Blackman windowed sinc for each position of a step between two samples, the first tap being the first sample at or
+ * after the step. Each phase is scaled so its taps add up to exactly 1 << 15, so adding up the deltas gets back to
+ * exactly the right level once a step has passed.
+ */
+static constexpr SN76489BlepKernel buildBlepKernel() {
+    SN76489BlepKernel kernel = {};
+
+    for (int phase = 0; phase < SN76489_BLEP_PHASES; phase++) {
+        double values[SN76489_BLEP_TAPS] = {};
+        double total = 0;
+
+        for (int tap = 0; tap < SN76489_BLEP_TAPS; tap++) {
+            // Distance in samples from the middle of the kernel
+            double x = tap + (double)phase / SN76489_BLEP_PHASES - SN76489_BLEP_TAPS / 2;
+            double sinc = x == 0 ? 2 * SN76489_BLEP_CUTOFF : blepSin(2 * SN76489_PI * SN76489_BLEP_CUTOFF * x) / (SN76489_PI * x);
+            double angle = 2 * SN76489_PI * x / SN76489_BLEP_TAPS;
+            double window = 0.42 + 0.5 * blepSin(angle + SN76489_PI / 2) + 0.08 * blepSin(2 * angle + SN76489_PI / 2);
+            values[tap] = sinc * window;
+            total += values[tap];
+        }
+
+        // Round the running total rather than each tap, so the rounding errors can't add up
+        double runningTotal = 0;
+        int previous = 0;
+
+        for (int tap = 0; tap < SN76489_BLEP_TAPS; tap++) {
+            runningTotal += values[tap];
+            double scaled = runningTotal * (1 << 15) / total;
+            int rounded = scaled < 0 ? -(int)(0.5 - scaled) : (int)(scaled + 0.5);
+            kernel.taps[phase][tap] = rounded - previous;
+            previous = rounded;
+        }
+    }
+
+    return kernel;
+}
+
+static constexpr SN76489BlepKernel blepKernel = buildBlepKernel();
+
+SN76489::SN76489() {
+    accessClock = nullptr;
+    vgmWriter = nullptr;
+    timingOnly = false;
+    reset();
+}
+
+void SN76489::reset() {
+    latchedRegister = 0;
+    noiseRegister = 0;
+    lfsr = 0x8000;
+    runTime = 0;
+
+    // Tone channels start with a period of 0, so held high, and everything is silent
+    for (int channel = 0; channel < SN76489_CHANNELS; channel++) {
+        volumes[channel] = 0x0F;
+        high[channel] = channel < 3;
+        amplitude[channel] = 0;
+        nextTransitionTime[channel] = SN76489_NEVER;
+    }
+
+    memset(toneRegisters, 0, sizeof(toneRegisters));
+    nextTransitionTime[3] = getNoisePeriod() * SN76489_MASTER_CYCLES_PER_TICK;
+
+    writeLog.clear();
+    nextSampleTime = SN76489_MASTER_CYCLES_PER_SAMPLE;
+    level = 0;
+    deltas.assign(SN76489_BLEP_TAPS + 1, 0);
+    output.clear();
+    samplesGenerated = 0;
+    transitions = 0;
+}
+
+/**
+ * @param masterClock - Master clock of whichever CPU is about to run, writes are logged at its time
+ */
+void SN76489::setAccessClock(const uint64_t *masterClock) {
+    accessClock = masterClock;
+}
+
+/**
+ * @param writer - Every write is recorded to it from now on, nullptr to stop
+ */
+void SN76489::setVGMWriter(VGMWriter *writer) {
+    vgmWriter = writer;
+}
+
+/**
+ * Applies the logged writes and runs the channels up to the given master clock time, then adds up the deltas into
+ * every sample due by then
+ */
+void SN76489::catchUp(uint64_t masterClock) {
+    size_t count = 0;
+
+    if (masterClock >= nextSampleTime) {
+        count = (masterClock - nextSampleTime) / SN76489_MASTER_CYCLES_PER_SAMPLE + 1;
+    }
+
+    if (timingOnly) {
+        runTime = std::max(runTime, masterClock);
+        nextSampleTime += count * SN76489_MASTER_CYCLES_PER_SAMPLE;
+        return;
+    }
+
+    // Steps up to masterClock land at most SN76489_BLEP_TAPS samples past the last sample due
+    if (deltas.size() < count + SN76489_BLEP_TAPS + 1) {
+        deltas.resize(count + SN76489_BLEP_TAPS + 1, 0);
+    }
+
+    size_t applied = 0;
+    sortSoundWrites(writeLog);
+
+    while (applied < writeLog.size() && writeLog[applied].time <= masterClock) {
+        runChannels(writeLog[applied].time);
+        applyWrite(writeLog[applied].value);
+        applied++;
+    }
+
+    writeLog.erase(writeLog.begin(), writeLog.begin() + applied);
+    runChannels(masterClock);
+
+    if (count == 0) {
+        return;
+    }
+
+    size_t start = output.size();
+    output.resize(start + count);
+
+    for (size_t i = 0; i < count; i++) {
+        level += deltas[i];
+        output[start + i] = (int16_t)std::clamp(level >> 15, -32768, 32767);
+    }
+
+    deltas.erase(deltas.begin(), deltas.begin() + count);
+    nextSampleTime += count * SN76489_MASTER_CYCLES_PER_SAMPLE;
+    samplesGenerated += count;
+}
+
+void SN76489::catchUpToAccess() {
+    if (accessClock != nullptr) {
+        catchUp(*accessClock);
+    }
+}
+
+/**
+ * Bytes with bit 7 set latch a channel (bits 5-6) and register type (bit 4, 1 for volume) and write the low 4 bits of
+ * it. Bytes without bit 7 set write the high 6 bits of a tone period, or the whole of the other registers.
+ *
+ * Without an access clock, or in timing only mode, the write is applied immediately.
+ */
+void SN76489::write(unsigned char value) {
+    if (vgmWriter != nullptr) {
+        vgmWriter->writePSG(accessClock != nullptr ? *accessClock : 0, value);
+    }
+
+    if (accessClock == nullptr || timingOnly) {
+        applyWrite(value);
+        return;
+    }
+
+    writeLog.push_back({*accessClock, 0, value});
+
+    if (writeLog.size() >= SOUND_WRITE_LOG_SIZE) {
+        catchUp(*accessClock);
+    }
+}
+
+/**
+ * Switches to (or back from) only following the register writes. Switching back restarts every channel's counter from
+ * where the chip was last caught up to.
+ */
+void SN76489::setTimingOnly(bool enabled) {
+    if (enabled == timingOnly) {
+        return;
+    }
+
+    timingOnly = true;
+
+    for (const SoundWrite &write : writeLog) {
+        applyWrite(write.value);
+    }
+
+    writeLog.clear();
+    timingOnly = enabled;
+
+    if (!enabled) {
+        restartChannels();
+    }
+}
+
+const std::vector<int16_t> &SN76489::getOutput() {
+    return output;
+}
+
+void SN76489::clearOutput() {
+    output.clear();
+}
+
+uint64_t SN76489::getSamplesGenerated() {
+    return samplesGenerated;
+}
+
+/**
+ * Changes in any channel's output, each one is a band-limited step
+ */
+uint64_t SN76489::getTransitions() {
+    return transitions;
+}
+
+void SN76489::applyWrite(unsigned char value) {
+    if (value & 0x80) {
+        latchedRegister = (value >> 4) & 0x07;
+    }
+
+    int channel = latchedRegister >> 1;
+
+    if (latchedRegister & 1) {
+        volumes[channel] = value & 0x0F;
+        updateAmplitude(channel, runTime);
+        return;
+    }
+
+    if (channel == 3) {
+        writeNoise(value);
+        return;
+    }
+
+    if (value & 0x80) {
+        writeTone(channel, (toneRegisters[channel] & 0x3F0) | (value & 0x0F));
+    } else {
+        writeTone(channel, (toneRegisters[channel] & 0x0F) | ((value & 0x3F) << 4));
+    }
+}
+
+/**
+ * A new period only takes effect when the channel's counter next reloads, apart from periods of 0 and 1 which hold the
+ * output high (games use this to play samples through the volume registers)
+ */
+void SN76489::writeTone(int channel, uint16_t period) {
+    bool wasHeld = toneRegisters[channel] <= 1;
+    toneRegisters[channel] = period;
+
+    if (period <= 1) {
+        nextTransitionTime[channel] = SN76489_NEVER;
+        high[channel] = true;
+        updateAmplitude(channel, runTime);
+    } else if (wasHeld) {
+        nextTransitionTime[channel] = getNextTickTime(runTime) + (period - 1) * SN76489_MASTER_CYCLES_PER_TICK;
+    }
+}
+
+/**
+ * Any write to the noise register resets the LFSR
+ */
+void SN76489::writeNoise(unsigned char value) {
+    noiseRegister = value & 0x07;
+    lfsr = 0x8000;
+    updateAmplitude(3, runTime);
+}
+
+/**
+ * Starts every channel's counter again from runTime, with nothing left of any steps still being added into the output
+ */
+void SN76489::restartChannels() {
+    uint64_t tickTime = getNextTickTime(runTime);
+    level = 0;
+
+    for (int channel = 0; channel < 3; channel++) {
+        nextTransitionTime[channel] = toneRegisters[channel] <= 1 ? SN76489_NEVER :
+                                      tickTime + (toneRegisters[channel] - 1) * SN76489_MASTER_CYCLES_PER_TICK;
+    }
+
+    nextTransitionTime[3] = tickTime + (getNoisePeriod() - 1) * SN76489_MASTER_CYCLES_PER_TICK;
+
+    for (int channel = 0; channel < SN76489_CHANNELS; channel++) {
+        level += amplitude[channel] * (1 << 15);
+    }
+
+    deltas.assign(SN76489_BLEP_TAPS + 1, 0);
+}
+
+void SN76489::runChannels(uint64_t masterClock) {
+    for (int channel = 0; channel < 3; channel++) {
+        runTone(channel, masterClock);
+    }
+
+    runNoise(masterClock);
+    runTime = std::max(runTime, masterClock);
+}
+
+/**
+ * Jumps from one transition to the next, the square wave flips each time the counter runs out
+ */
+void SN76489::runTone(int channel, uint64_t masterClock) {
+    while (nextTransitionTime[channel] <= masterClock) {
+        high[channel] = !high[channel];
+        updateAmplitude(channel, nextTransitionTime[channel]);
+        nextTransitionTime[channel] += toneRegisters[channel] * SN76489_MASTER_CYCLES_PER_TICK;
+    }
+}
+
+/**
+ * The noise counter flips a flip-flop each time it runs out, and the LFSR shifts when that goes high. White noise feeds
+ * back bits 0 and 3, periodic noise just bit 0. The output is bit 0.
+ */
+void SN76489::runNoise(uint64_t masterClock) {
+    while (nextTransitionTime[3] <= masterClock) {
+        high[3] = !high[3];
+
+        if (high[3]) {
+            unsigned int feedback = (noiseRegister & 0x04) ? ((lfsr ^ (lfsr >> 3)) & 1) : (lfsr & 1);
+            lfsr = (lfsr >> 1) | (feedback << 15);
+            updateAmplitude(3, nextTransitionTime[3]);
+        }
+
+        nextTransitionTime[3] += getNoisePeriod() * SN76489_MASTER_CYCLES_PER_TICK;
+    }
+}
+
+/**
+ * Shift rates 0-2 are fixed, 3 uses the third tone channel's period
+ */
+int SN76489::getNoisePeriod() {
+    if ((noiseRegister & 0x03) == 0x03) {
+        return std::max((int)toneRegisters[2], 1);
+    }
+
+    return 0x10 << (noiseRegister & 0x03);
+}
+
+uint64_t SN76489::getNextTickTime(uint64_t masterClock) {
+    return (masterClock / SN76489_MASTER_CYCLES_PER_TICK + 1) * SN76489_MASTER_CYCLES_PER_TICK;
+}
+
+int SN76489::getChannelAmplitude(int channel) {
+    bool on = channel == 3 ? (lfsr & 1) : high[channel];
+    return on ? volumeTable[volumes[channel]] : -volumeTable[volumes[channel]];
+}
+
+void SN76489::updateAmplitude(int channel, uint64_t time) {
+    int value = getChannelAmplitude(channel);
+
+    if (value != amplitude[channel]) {
+        if (!timingOnly) {
+            addStep(time, value - amplitude[channel]);
+            transitions++;
+        }
+
+        amplitude[channel] = value;
+    }
+}
+
+/**
+ * Adds a band-limited step to the samples from the first one at or after the given time
+ */
+void SN76489::addStep(uint64_t time, int delta) {
+    size_t index = 0;
+    uint64_t offset = nextSampleTime - time;
+
+    if (time > nextSampleTime) {
+        index = (time - nextSampleTime + SN76489_MASTER_CYCLES_PER_SAMPLE - 1) / SN76489_MASTER_CYCLES_PER_SAMPLE;
+        offset = nextSampleTime + index * SN76489_MASTER_CYCLES_PER_SAMPLE - time;
+    }
+
+    // A write can land right on a sample that has already been generated, it goes in the next one instead
+    int phase = std::min((int)(offset * SN76489_BLEP_PHASES / SN76489_MASTER_CYCLES_PER_SAMPLE), SN76489_BLEP_PHASES - 1);
+    const int32_t *kernel = blepKernel.taps[phase];
+    int32_t *target = &deltas[index];
+
+    for (int tap = 0; tap < SN76489_BLEP_TAPS; tap++) {
+        target[tap] += delta * kernel[tap];
+    }
+}
+
+void SN76489::getSaveStateData(SN76489SaveStateData &data) {
+    // Nothing in the log is saved, so apply it first
+    catchUpToAccess();
+
+    memcpy(data.toneRegisters, toneRegisters, sizeof(toneRegisters));
+    data.noiseRegister = noiseRegister;
+    memcpy(data.volumes, volumes, sizeof(volumes));
+    data.latchedRegister = latchedRegister;
+    memcpy(data.nextTransitionTime, nextTransitionTime, sizeof(nextTransitionTime));
+    memcpy(data.high, high, sizeof(high));
+    memcpy(data.amplitude, amplitude, sizeof(amplitude));
+    data.lfsr = lfsr;
+    data.runTime = runTime;
+    data.nextSampleTime = nextSampleTime;
+    data.level = level;
+    memcpy(data.pendingDeltas, deltas.data(), sizeof(data.pendingDeltas));
+}
+
+void SN76489::restoreState(const SN76489SaveStateData &data) {
+    memcpy(toneRegisters, data.toneRegisters, sizeof(toneRegisters));
+    noiseRegister = data.noiseRegister;
+    memcpy(volumes, data.volumes, sizeof(volumes));
+    latchedRegister = data.latchedRegister;
+    memcpy(nextTransitionTime, data.nextTransitionTime, sizeof(nextTransitionTime));
+    memcpy(high, data.high, sizeof(high));
+    memcpy(amplitude, data.amplitude, sizeof(amplitude));
+    lfsr = data.lfsr;
+    runTime = data.runTime;
+    nextSampleTime = data.nextSampleTime;
+    level = data.level;
+    deltas.assign(data.pendingDeltas, data.pendingDeltas + SN76489_BLEP_TAPS);
+    deltas.push_back(0);
+    writeLog.clear();
+    output.clear();
+}
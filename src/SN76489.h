@@ -0,0 +1,154 @@
+#ifndef MEGANOSTALGIA_SN76489_H
+#define MEGANOSTALGIA_SN76489_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "SoundWriteLog.h"
+#include "VGMWriter.h"
+
+// 3 tone channels and the noise channel
+#define SN76489_CHANNELS 4
+
+// The PSG is clocked by the Z80 clock (master / 15) and its counters step once every 16 of those clocks
+#define SN76489_MASTER_CYCLES_PER_TICK (15 * 16)
+
+// Samples are generated at the same rate as the YM2612, so the two can be mixed sample for sample
+#define SN76489_MASTER_CYCLES_PER_SAMPLE (7 * 144)
+
+// Band-limited steps are stored for this many positions between two samples, each spread over this many samples
+#define SN76489_BLEP_PHASES 32
+#define SN76489_BLEP_TAPS 16
+
+// Never moves, used for the next transition of a channel that is held high
+#define SN76489_NEVER UINT64_MAX
+
+struct SN76489SaveStateData {
+    uint16_t toneRegisters[3];
+    unsigned char noiseRegister;
+    unsigned char volumes[SN76489_CHANNELS];
+    unsigned char latchedRegister;
+    uint64_t nextTransitionTime[SN76489_CHANNELS];
+    bool high[SN76489_CHANNELS];
+    int amplitude[SN76489_CHANNELS];
+    uint16_t lfsr;
+    uint64_t runTime;
+    uint64_t nextSampleTime;
+    int32_t level;
+    int32_t pendingDeltas[SN76489_BLEP_TAPS];
+};
+
+static_assert(std::is_trivially_copyable<SN76489SaveStateData>::value, "SN76489SaveStateData must be trivially copyable");
+
+/**
+ * The SN76489 compatible PSG built into the VDP: 3 square wave channels and a noise channel driven by a 16 bit LFSR.
+ *
+ * Nothing is ticked at the chip's clock rate. Each channel knows the master clock time of its next transition and jumps
+ * straight to it, and every transition adds a band-limited step (BLEP) to a buffer of deltas which is summed into the
+ * output samples. The cost goes with the number of transitions rather than the ~224KHz counter rate, and the square
+ * waves don't alias.
+ *
+ * Writes are logged in the same way as the YM2612 and only applied when the chip is caught up.
+ *
+ * In timing only mode the channels aren't run at all, writes just update the registers. Nothing about the PSG can be
+ * read back, so there is nothing else to keep.
+ */
+class SN76489 {
+public:
+
+    SN76489();
+
+    void reset();
+
+    void setAccessClock(const uint64_t *masterClock);
+
+    void setVGMWriter(VGMWriter *writer);
+
+    void catchUp(uint64_t masterClock);
+
+    void write(unsigned char value);
+
+    void setTimingOnly(bool enabled);
+
+    const std::vector<int16_t> &getOutput();
+
+    void clearOutput();
+
+    uint64_t getSamplesGenerated();
+
+    uint64_t getTransitions();
+
+    void getSaveStateData(SN76489SaveStateData &data);
+
+    void restoreState(const SN76489SaveStateData &data);
+
+private:
+
+    // 10 bit tone periods in ticks
+    uint16_t toneRegisters[3];
+
+    // Bit 2 - white noise (rather than periodic), bits 0-1 - shift rate
+    unsigned char noiseRegister;
+
+    // 4 bit attenuation, 2dB a step, 15 is off
+    unsigned char volumes[SN76489_CHANNELS];
+
+    // Channel (bits 1-2) and type (bit 0, 1 for volume) that data bytes go to
+    unsigned char latchedRegister;
+
+    uint64_t nextTransitionTime[SN76489_CHANNELS];
+
+    // Tone channels: the square wave's level. Noise: the flip-flop that shifts the LFSR when it goes high.
+    bool high[SN76489_CHANNELS];
+
+    // What each channel currently contributes to the output
+    int amplitude[SN76489_CHANNELS];
+
+    uint16_t lfsr;
+
+    // Every transition up to this time has been added
+    uint64_t runTime;
+
+    const uint64_t *accessClock;
+    VGMWriter *vgmWriter;
+    std::vector<SoundWrite> writeLog;
+
+    // deltas[0] is the sample at nextSampleTime, level is the running total of everything before it
+    uint64_t nextSampleTime;
+    int32_t level;
+    std::vector<int32_t> deltas;
+
+    std::vector<int16_t> output;
+    uint64_t samplesGenerated;
+    uint64_t transitions;
+
+    bool timingOnly;
+
+    void catchUpToAccess();
+
+    void applyWrite(unsigned char value);
+
+    void writeTone(int channel, uint16_t period);
+
+    void writeNoise(unsigned char value);
+
+    void restartChannels();
+
+    void runChannels(uint64_t masterClock);
+
+    void runTone(int channel, uint64_t masterClock);
+
+    void runNoise(uint64_t masterClock);
+
+    int getNoisePeriod();
+
+    uint64_t getNextTickTime(uint64_t masterClock);
+
+    int getChannelAmplitude(int channel);
+
+    void updateAmplitude(int channel, uint64_t time);
+
+    void addStep(uint64_t time, int delta);
+};
+
+#endif //MEGANOSTALGIA_SN76489_H
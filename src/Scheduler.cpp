@@ -0,0 +1,105 @@
+#include "Scheduler.h"
+
+Scheduler::Scheduler() {
+    reset();
+}
+
+void Scheduler::reset() {
+    masterClock = 0;
+
+    for (auto &eventTime : eventTimes) {
+        eventTime = SCHEDULER_NO_EVENT;
+    }
+
+    nextEventTime = SCHEDULER_NO_EVENT;
+}
+
+uint64_t Scheduler::getMasterClock() {
+    return masterClock;
+}
+
+/**
+ * Moves the master clock forward, should only be called once every component has been run up to the given time
+ * @param time
+ */
+void Scheduler::advanceTo(uint64_t time) {
+    masterClock = time;
+}
+
+/**
+ * Schedules an event, replacing any pending event of the same type
+ * @param event
+ * @param time - Master clock time at which the event should happen
+ */
+void Scheduler::schedule(SchedulerEvent event, uint64_t time) {
+    eventTimes[event] = time;
+
+    if (time < nextEventTime) {
+        nextEventTime = time;
+    }
+}
+
+void Scheduler::cancel(SchedulerEvent event) {
+    eventTimes[event] = SCHEDULER_NO_EVENT;
+    updateNextEventTime();
+}
+
+/**
+ * Returns the master clock time of the next pending event - components can run uninterrupted until then
+ */
+uint64_t Scheduler::getNextEventTime() {
+    return nextEventTime;
+}
+
+/**
+ * Removes the earliest event which is due at the current master clock time
+ * @param event - Populated with the event which is due
+ * @return - False if there is nothing left to handle
+ */
+bool Scheduler::getDueEvent(SchedulerEvent &event) {
+    if (nextEventTime > masterClock) {
+        return false;
+    }
+
+    int earliest = 0;
+
+    for (int i = 1; i < SchedulerEventCount; i++) {
+        if (eventTimes[i] < eventTimes[earliest]) {
+            earliest = i;
+        }
+    }
+
+    event = (SchedulerEvent)earliest;
+    eventTimes[earliest] = SCHEDULER_NO_EVENT;
+    updateNextEventTime();
+
+    return true;
+}
+
+void Scheduler::getSaveStateData(SchedulerSaveStateData &data) {
+    data.masterClock = masterClock;
+
+    for (int i = 0; i < SchedulerEventCount; i++) {
+        data.eventTimes[i] = eventTimes[i];
+    }
+}
+
+void Scheduler::restoreState(const SchedulerSaveStateData &data) {
+    masterClock = data.masterClock;
+
+    for (int i = 0; i < SchedulerEventCount; i++) {
+        eventTimes[i] = data.eventTimes[i];
+    }
+
+    updateNextEventTime();
+}
+
+void Scheduler::updateNextEventTime() {
+    nextEventTime = SCHEDULER_NO_EVENT;
+
+    for (auto &eventTime : eventTimes) {
+        if (eventTime < nextEventTime) {
+            nextEventTime = eventTime;
+        }
+    }
+}
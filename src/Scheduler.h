@@ -0,0 +1,74 @@
+#ifndef MEGANOSTALGIA_SCHEDULER_H
+#define MEGANOSTALGIA_SCHEDULER_H
+
+#include <cstdint>
+#include <type_traits>
+
+// NTSC timings, in master clock cycles - From https://segaretro.org/Sega_Mega_Drive/Technical_specifications
+// TODO handle PAL timings
+#define MASTER_CLOCK_RATE 53693175
+#define MASTER_CYCLES_PER_LINE 3420
+#define LINES_PER_FRAME 262
+#define VINT_LINE 224
+
+#define M68K_CLOCK_DIVIDER 7
+#define Z80_CLOCK_DIVIDER 15
+
+// The Z80 /INT line is held for 171 Z80 cycles (roughly one scanline) after VINT. If interrupts are disabled for
+// that whole time the interrupt is missed.
+#define Z80_INTERRUPT_PULSE_LENGTH (171 * Z80_CLOCK_DIVIDER)
+
+#define SCHEDULER_NO_EVENT UINT64_MAX
+
+enum SchedulerEvent {
+    VInt,
+    Z80InterruptEnd,
+    SchedulerEventCount
+};
+
+struct SchedulerSaveStateData {
+    uint64_t masterClock;
+    uint64_t eventTimes[SchedulerEventCount];
+};
+
+static_assert(std::is_trivially_copyable<SchedulerSaveStateData>::value, "SchedulerSaveStateData must be trivially copyable");
+
+/**
+ * Keeps track of the master clock and when the next thing which affects more than one component needs to happen.
+ * Each type of event can only be pending once, the CPUs are run up until the next event rather than checking for
+ * these conditions on every instruction.
+ */
+class Scheduler {
+public:
+    Scheduler();
+
+    void reset();
+
+    uint64_t getMasterClock();
+
+    void advanceTo(uint64_t time);
+
+    void schedule(SchedulerEvent event, uint64_t time);
+
+    void cancel(SchedulerEvent event);
+
+    uint64_t getNextEventTime();
+
+    bool getDueEvent(SchedulerEvent &event);
+
+    void getSaveStateData(SchedulerSaveStateData &data);
+
+    void restoreState(const SchedulerSaveStateData &data);
+
+private:
+
+    uint64_t masterClock;
+
+    uint64_t eventTimes[SchedulerEventCount];
+
+    uint64_t nextEventTime;
+
+    void updateNextEventTime();
+};
+
+#endif //MEGANOSTALGIA_SCHEDULER_H
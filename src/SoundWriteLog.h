@@ -0,0 +1,35 @@
+#ifndef MEGANOSTALGIA_SOUNDWRITELOG_H
+#define MEGANOSTALGIA_SOUNDWRITELOG_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// A sound chip's log is applied early once this many writes are waiting, rather than at the end of the frame
+#define SOUND_WRITE_LOG_SIZE 1024
+
+/**
+ * A port write to a sound chip, recorded with the master clock time it happened at so the chip can be run up to it
+ * later in one go
+ */
+struct SoundWrite {
+    uint64_t time;
+    unsigned char port;
+    unsigned char value;
+};
+
+/**
+ * The 68k runs through a whole slice before the Z80 does, so a log can have the 68k's later writes ahead of the Z80's
+ * earlier ones. Puts it back into time order, keeping writes made at the same time in the order they were made.
+ */
+inline void sortSoundWrites(std::vector<SoundWrite> &log) {
+    auto earlier = [](const SoundWrite &a, const SoundWrite &b) {
+        return a.time < b.time;
+    };
+
+    if (!std::is_sorted(log.begin(), log.end(), earlier)) {
+        std::stable_sort(log.begin(), log.end(), earlier);
+    }
+}
+
+#endif //MEGANOSTALGIA_SOUNDWRITELOG_H
@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <cstring>
+#include "VDP.h"
+#include "VDPRenderThread.h"
+
+// Last line before the V counter jumps back and the value it jumps to (9 bits), [PAL][V30]
+static const int vCounterJumps[2][2][2] = {
+        {{0x0EA, 0x1E5}, {0x1FF, 0x000}},
+        {{0x102, 0x1CA}, {0x10A, 0x1D2}}
+};
+
+VDP::VDP() {
+    memory = nullptr;
+    accessClock = nullptr;
+    pal = false;
+    renderThread = nullptr;
+    activeWriteLog = 0;
+    renderSkipEnabled = true;
+    pixelFormat = VDPPixelFormat::XRGB8888;
+    buildColourLUT();
+    buildHCounterTable();
+    reset();
+}
+
+VDP::~VDP() {
+    setRenderThreaded(false);
+}
+
+void VDP::reset() {
+    if (renderThread != nullptr) {
+        syncRenderThread();
+        renderThread->getRenderer()->reset();
+    }
+
+    memset(vram, 0, sizeof(vram));
+    memset(cram, 0, sizeof(cram));
+    memset(vsram, 0, sizeof(vsram));
+    memset(registers, 0, sizeof(registers));
+    memset(framebuffer, 0, sizeof(framebuffer));
+
+    address = 0;
+    code = 0;
+    controlWritePending = false;
+
+    vIntPending = false;
+    spriteOverflow = false;
+    spriteCollision = false;
+    vBlank = false;
+
+    // Left on the last line of the previous frame, so line 0 starts (and is drawn) the first time the VDP catches up
+    currentLine = LINES_PER_FRAME - 1;
+    nextLineTime = 0;
+    dmaFillPending = false;
+    dmaSlotsRemaining = 0;
+    m68kStallCycles = 0;
+
+    linesRendered = 0;
+    generation = 0;
+    framebufferGeneration = VDP_NO_GENERATION;
+    frameGeneration = 0;
+    frameUniform = false;
+    frameLinesReused = 0;
+    framesRendered = 0;
+    framesReused = 0;
+
+    for (int i = 0; i < VDP_CRAM_SIZE; i++) {
+        updatePaletteEntry(i);
+    }
+
+    tilesDecoded = 0;
+    markAllTilesDirty();
+    updateSpriteTable();
+}
+
+/**
+ * DMA transfers from 68k memory read from here, must be set before the 68k runs
+ */
+void VDP::setMemory(Memory *memory) {
+    this->memory = memory;
+}
+
+uint16_t VDP::readData() {
+    catchUpToAccess();
+    uint16_t value = 0;
+    controlWritePending = false;
+
+    switch (code & 0x0F) {
+        case VDPAccessCode::VRAMRead:
+            value = (vram[address & 0xFFFE] << 8) | vram[address | 1];
+            break;
+        case VDPAccessCode::CRAMRead:
+            value = cram[(address >> 1) & 0x3F];
+            break;
+        case VDPAccessCode::VSRAMRead:
+            if (((address >> 1) & 0x3F) < VDP_VSRAM_SIZE) {
+                value = vsram[(address >> 1) & 0x3F];
+            }
+            break;
+        default:
+            break;
+    }
+
+    address += registers[15];
+    return value;
+}
+
+/**
+ * Reads the status register
+ *
+ * Bit 9 - FIFO empty, 8 - FIFO full, 7 - VINT pending, 6 - sprite overflow, 5 - sprite collision, 3 - vertical
+ * blanking, 2 - horizontal blanking, 1 - DMA busy, 0 - PAL
+ *
+ * There is no write FIFO, data port writes go straight into memory, so it always reads as empty and never full.
+ * Horizontal blanking is set while the H counter is outside the active pixels of the line.
+ */
+uint16_t VDP::readControl() {
+    catchUpToAccess();
+
+    uint16_t status = 0x3600;
+    status |= pal;
+    status |= (dmaSlotsRemaining > 0) << 1;
+    status |= (hCounterTable[isH40Mode()][getLineCycle()] >= getActiveWidth() / 2) << 2;
+    status |= vIntPending << 7;
+    status |= spriteOverflow << 6;
+    status |= spriteCollision << 5;
+    status |= (vBlank || !(registers[1] & 0x40)) << 3;
+
+    controlWritePending = false;
+    spriteOverflow = false;
+    spriteCollision = false;
+
+    return status;
+}
+
+/**
+ * V counter in the high byte, H counter in the low byte, worked out from how far through the current line the 68k is.
+ * Nothing is updated per cycle so this can be polled as often as a game likes.
+ */
+uint16_t VDP::readHVCounter() {
+    catchUpToAccess();
+    return (getVCounter() << 8) | hCounterTable[isH40Mode()][getLineCycle()];
+}
+
+/**
+ * Master clock cycles since the current line started, as of the last access. Always 0 when there is no clock.
+ */
+int VDP::getLineCycle() {
+    if (accessClock == nullptr) {
+        return 0;
+    }
+
+    return (int)std::min(*accessClock - (nextLineTime - MASTER_CYCLES_PER_LINE), (uint64_t)MASTER_CYCLES_PER_LINE - 1);
+}
+
+/**
+ * The V counter counts lines but jumps back partway through vertical blanking, so that it reaches 0x1FF on the last
+ * line. Only the low 8 bits can be read.
+ */
+uint16_t VDP::getVCounter() {
+    const int *jump = vCounterJumps[pal][(registers[1] & 0x08) != 0];
+    int counter = currentLine <= jump[0] ? currentLine : currentLine - jump[0] - 1 + jump[1];
+    return counter & 0xFF;
+}
+
+/**
+ * The 9 bit H counter counts pixels (0x000-0x16C then 0x1C9-0x1FF in H40, 0x000-0x127 then 0x1D2-0x1FF in H32),
+ * reads return the top 8 bits
+ */
+void VDP::buildHCounterTable() {
+    for (int cycle = 0; cycle < MASTER_CYCLES_PER_LINE; cycle++) {
+        int h40Pixel = cycle * 420 / MASTER_CYCLES_PER_LINE;
+        int h32Pixel = cycle * 342 / MASTER_CYCLES_PER_LINE;
+        hCounterTable[1][cycle] = (h40Pixel <= 0x16C ? h40Pixel : h40Pixel - 0x16D + 0x1C9) >> 1;
+        hCounterTable[0][cycle] = (h32Pixel <= 0x127 ? h32Pixel : h32Pixel - 0x128 + 0x1D2) >> 1;
+    }
+}
+
+/**
+ * Selects the PAL V counter sequence and status flag. Line timings still come from the scheduler.
+ */
+void VDP::setPAL(bool pal) {
+    this->pal = pal;
+}
+
+void VDP::writeData(uint16_t value) {
+    catchUpToAccess();
+    controlWritePending = false;
+
+    switch (code & 0x0F) {
+        case VDPAccessCode::VRAMWrite: {
+            // Writes to odd addresses store the bytes the other way around
+            uint16_t word = (address & 1) ? (value << 8) | (value >> 8) : value;
+
+            // Games often write the same data every frame, only real changes need the caches updating
+            if (vram[address & 0xFFFE] != word >> 8 || vram[address | 1] != (word & 0xFF)) {
+                vram[address & 0xFFFE] = word >> 8;
+                vram[address | 1] = word & 0xFF;
+                handleVRAMWrite(address);
+            }
+            break;
+        }
+        case VDPAccessCode::CRAMWrite:
+            if (cram[(address >> 1) & 0x3F] != (value & 0x0EEE)) {
+                cram[(address >> 1) & 0x3F] = value & 0x0EEE;
+                handleCRAMWrite((address >> 1) & 0x3F);
+            }
+            break;
+        case VDPAccessCode::VSRAMWrite:
+            if (((address >> 1) & 0x3F) < VDP_VSRAM_SIZE && vsram[(address >> 1) & 0x3F] != (value & 0x07FF)) {
+                vsram[(address >> 1) & 0x3F] = value & 0x07FF;
+                handleVSRAMWrite((address >> 1) & 0x3F);
+            }
+            break;
+        default:
+            break;
+    }
+
+    address += registers[15];
+
+    if (dmaFillPending) {
+        runFillDMA(value);
+    }
+}
+
+/**
+ * Either a register write (10xR RRRR DDDD DDDD) or one half of a two word command that sets up the access code and
+ * address for the data port:
+ *
+ * First word - CD1 CD0 A13-A0, Second word - 0000 0000 CD5-CD2 00 A15 A14
+ */
+void VDP::writeControl(uint16_t value) {
+    catchUpToAccess();
+    if (!controlWritePending) {
+        if ((value & 0xC000) == 0x8000) {
+            writeRegister((value >> 8) & 0x1F, value & 0xFF);
+            return;
+        }
+
+        code = (code & 0x3C) | ((value >> 14) & 0x03);
+        address = (address & 0xC000) | (value & 0x3FFF);
+        controlWritePending = true;
+        return;
+    }
+
+    code = (code & 0x03) | ((value >> 2) & 0x3C);
+    address = (address & 0x3FFF) | ((value & 0x03) << 14);
+    controlWritePending = false;
+
+    // CD5 starts a DMA, if DMA is enabled
+    if ((code & 0x20) && (registers[1] & 0x10)) {
+        startDMA();
+    }
+}
+
+void VDP::writeRegister(int reg, unsigned char value) {
+    if (reg >= VDP_REGISTER_COUNT) {
+        return;
+    }
+
+    if (registers[reg] == value) {
+        return;
+    }
+
+    registers[reg] = value;
+    generation++;
+
+    if (renderThread != nullptr) {
+        logWrite(VDPWriteLogEntryType::RegisterData, reg, value);
+    }
+
+    // The sprite table address and the number of sprites depend on registers 5 and 12
+    if (reg == 5 || reg == 12) {
+        updateSpriteTable();
+    }
+}
+
+/**
+ * Keeps the tile cache and sprite table copy up to date after a VRAM word has been written
+ */
+void VDP::handleVRAMWrite(uint16_t vramAddress) {
+    generation++;
+
+    if (renderThread != nullptr) {
+        logVRAMWrite(vramAddress & 0xFFFE, 2);
+    }
+
+    markTileDirty(vramAddress);
+
+    uint16_t spriteTableOffset = vramAddress - spriteTableAddress;
+
+    if (spriteTableOffset < getMaxSprites() * 8) {
+        updateSpriteTableEntry(spriteTableOffset >> 3);
+    }
+}
+
+/**
+ * The same as handleVRAMWrite but for a whole range at once (wrapping at the end of VRAM), used by DMA
+ */
+void VDP::handleVRAMRangeWrite(uint16_t vramAddress, uint32_t length) {
+    generation++;
+
+    if (renderThread != nullptr) {
+        logVRAMWrite(vramAddress, length);
+    }
+
+    if (length >= VDP_VRAM_SIZE) {
+        markAllTilesDirty();
+        updateSpriteTable();
+        return;
+    }
+
+    uint32_t firstTile = vramAddress >> 5;
+    uint32_t lastTile = (vramAddress + length - 1) >> 5;
+
+    for (uint32_t tile = firstTile; tile <= lastTile; tile++) {
+        markTileDirty((tile & (VDP_TILE_COUNT - 1)) << 5);
+    }
+
+    for (int index = 0; index < getMaxSprites(); index++) {
+        uint16_t entryAddress = spriteTableAddress + (index << 3);
+
+        if ((uint16_t)(entryAddress - vramAddress) < length || (uint16_t)(vramAddress - entryAddress) < 8) {
+            updateSpriteTableEntry(index);
+        }
+    }
+}
+
+void VDP::handleCRAMWrite(int index) {
+    updatePaletteEntry(index);
+
+    if (renderThread != nullptr) {
+        logWrite(VDPWriteLogEntryType::CRAMData, index, cram[index]);
+    }
+}
+
+void VDP::handleVSRAMWrite(int index) {
+    generation++;
+
+    if (renderThread != nullptr) {
+        logWrite(VDPWriteLogEntryType::VSRAMData, index, vsram[index]);
+    }
+}
+
+void VDP::markTileDirty(uint16_t vramAddress) {
+    uint16_t tile = vramAddress >> 5;
+
+    if (!tileDirty[tile]) {
+        tileDirty[tile] = true;
+        dirtyTiles[dirtyTileCount++] = tile;
+    }
+}
+
+void VDP::markAllTilesDirty() {
+    for (int tile = 0; tile < VDP_TILE_COUNT; tile++) {
+        tileDirty[tile] = true;
+        dirtyTiles[tile] = tile;
+    }
+
+    dirtyTileCount = VDP_TILE_COUNT;
+}
+
+/**
+ * @param masterClock - Master clock of the CPU that accesses the ports (the 68k), or nullptr if lines are started by
+ * calling startLine directly
+ */
+void VDP::setAccessClock(const uint64_t *masterClock) {
+    accessClock = masterClock;
+}
+
+/**
+ * Starts every line that should have started by the given master clock time
+ */
+void VDP::catchUp(uint64_t masterClock) {
+    while (masterClock >= nextLineTime) {
+        nextLineTime += MASTER_CYCLES_PER_LINE;
+        startLine((currentLine + 1) % LINES_PER_FRAME);
+    }
+}
+
+void VDP::catchUpToAccess() {
+    if (accessClock != nullptr) {
+        catchUp(*accessClock);
+    }
+}
+
+/**
+ * Renders visible lines and keeps track of vertical blanking, called by catchUp (or directly when there is no clock)
+ */
+void VDP::startLine(int line) {
+    currentLine = line;
+    vBlank = line >= VDP_SCREEN_HEIGHT;
+
+    if (dmaSlotsRemaining > 0) {
+        dmaSlotsRemaining = std::max(dmaSlotsRemaining - getDMASlotsPerLine(line), 0);
+    }
+
+    // The 68k can't take interrupts yet, so nothing acknowledges VINT. It is cleared at the start of the next frame
+    // instead, which leaves it set for longer than it would be if a game took the interrupt.
+    if (line == 0) {
+        vIntPending = false;
+    }
+
+    if (vBlank) {
+        return;
+    }
+
+    // The render thread draws the line once the frame has been handed over, the sprite flags are needed straight away
+    if (renderThread != nullptr) {
+        updateSpriteStatus(line);
+        logWrite(VDPWriteLogEntryType::StartLine, line, 0);
+
+        if (line == VDP_SCREEN_HEIGHT - 1) {
+            submitWriteLog();
+        }
+        return;
+    }
+
+    if (line == 0) {
+        frameGeneration = generation;
+        frameUniform = true;
+        frameLinesReused = 0;
+    }
+
+    if (renderSkipEnabled && generation == framebufferGeneration) {
+        reuseLine(line);
+    } else {
+        renderLine(line);
+    }
+
+    if (generation != frameGeneration) {
+        frameUniform = false;
+    }
+
+    if (line == VDP_SCREEN_HEIGHT - 1) {
+        framebufferGeneration = frameUniform ? frameGeneration : VDP_NO_GENERATION;
+
+        if (frameLinesReused == VDP_SCREEN_HEIGHT) {
+            framesReused++;
+        } else {
+            framesRendered++;
+        }
+    }
+}
+
+/**
+ * The line in the framebuffer is already up to date, only the sprite status flags it raised need setting again
+ */
+void VDP::reuseLine(int line) {
+    spriteOverflow |= lineSpriteStatus[line] & 0x01;
+    spriteCollision |= (lineSpriteStatus[line] & 0x02) != 0;
+    frameLinesReused++;
+}
+
+/**
+ * Returns (and clears) how long the 68k has been frozen for by DMA since this was last called
+ */
+uint32_t VDP::takeM68kStallCycles() {
+    uint32_t cycles = m68kStallCycles;
+    m68kStallCycles = 0;
+    return cycles;
+}
+
+/**
+ * Sets the VINT pending flag, the 68k interrupt itself is raised by the emulator if register 1 has it enabled
+ */
+void VDP::triggerVInt() {
+    vIntPending = true;
+}
+
+/**
+ * Changes the format lines are rendered in from now on, e.g. headless users can ask for indexed output to cut
+ * framebuffer bandwidth
+ */
+void VDP::setPixelFormat(VDPPixelFormat format) {
+    if (renderThread != nullptr) {
+        syncRenderThread();
+        renderThread->getRenderer()->setPixelFormat(format);
+    }
+
+    pixelFormat = format;
+    buildColourLUT();
+
+    for (int i = 0; i < VDP_CRAM_SIZE; i++) {
+        updatePaletteEntry(i);
+    }
+
+    memset(framebuffer, 0, sizeof(framebuffer));
+    framebufferGeneration = VDP_NO_GENERATION;
+}
+
+VDPPixelFormat VDP::getPixelFormat() {
+    return pixelFormat;
+}
+
+/**
+ * When rendering is threaded this waits for the render thread to catch up, so the framebuffer is the same as it would
+ * be single threaded. It is this VDP's copy either way, the render thread never draws into it.
+ */
+const unsigned char *VDP::getFramebuffer() {
+    if (renderThread != nullptr) {
+        syncRenderThread();
+    }
+
+    return framebuffer;
+}
+
+/**
+ * Bytes per line of the framebuffer (VDP_SCREEN_WIDTH pixels in the current format)
+ */
+int VDP::getFramebufferPitch() {
+    return VDP_SCREEN_WIDTH * getBytesPerPixel();
+}
+
+int VDP::getBytesPerPixel() {
+    switch (pixelFormat) {
+        case VDPPixelFormat::RGB565:
+            return 2;
+        case VDPPixelFormat::Indexed8:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+uint64_t VDP::getLinesRendered() {
+    return getRenderer()->linesRendered;
+}
+
+uint64_t VDP::getTilesDecoded() {
+    return getRenderer()->tilesDecoded;
+}
+
+uint64_t VDP::getFramesRendered() {
+    return getRenderer()->framesRendered;
+}
+
+uint64_t VDP::getFramesReused() {
+    return getRenderer()->framesReused;
+}
+
+/**
+ * Render skipping is on by default, turning it off makes every line be drawn (e.g. for benchmarking the renderer)
+ */
+void VDP::setRenderSkipEnabled(bool enabled) {
+    if (renderThread != nullptr) {
+        syncRenderThread();
+        renderThread->getRenderer()->renderSkipEnabled = enabled;
+    }
+
+    renderSkipEnabled = enabled;
+}
+
+bool VDP::isH40Mode() {
+    return registers[12] & 0x01;
+}
+
+int VDP::getActiveWidth() {
+    return isH40Mode() ? 320 : 256;
+}
+
+int VDP::getMaxSprites() {
+    return isH40Mode() ? 80 : 64;
+}
+
+void VDP::getSaveStateData(VDPSaveStateData &data) {
+    memcpy(data.vram, vram, sizeof(vram));
+    memcpy(data.cram, cram, sizeof(cram));
+    memcpy(data.vsram, vsram, sizeof(vsram));
+    memcpy(data.registers, registers, sizeof(registers));
+    data.address = address;
+    data.code = code;
+    data.controlWritePending = controlWritePending;
+    data.vIntPending = vIntPending;
+    data.spriteOverflow = spriteOverflow;
+    data.spriteCollision = spriteCollision;
+    data.vBlank = vBlank;
+    data.dmaFillPending = dmaFillPending;
+    data.dmaSlotsRemaining = dmaSlotsRemaining;
+    data.currentLine = currentLine;
+    data.nextLineTime = nextLineTime;
+}
+
+void VDP::restoreState(const VDPSaveStateData &data) {
+    memcpy(vram, data.vram, sizeof(vram));
+    memcpy(cram, data.cram, sizeof(cram));
+    memcpy(vsram, data.vsram, sizeof(vsram));
+    memcpy(registers, data.registers, sizeof(registers));
+    address = data.address;
+    code = data.code;
+    controlWritePending = data.controlWritePending;
+    vIntPending = data.vIntPending;
+    spriteOverflow = data.spriteOverflow;
+    spriteCollision = data.spriteCollision;
+    vBlank = data.vBlank;
+    dmaFillPending = data.dmaFillPending;
+    dmaSlotsRemaining = data.dmaSlotsRemaining;
+    currentLine = data.currentLine;
+    nextLineTime = data.nextLineTime;
+
+    // The framebuffer isn't part of the save state
+    framebufferGeneration = VDP_NO_GENERATION;
+    frameUniform = false;
+
+    for (int i = 0; i < VDP_CRAM_SIZE; i++) {
+        updatePaletteEntry(i);
+    }
+
+    markAllTilesDirty();
+    updateSpriteTable();
+
+    if (renderThread != nullptr) {
+        syncRenderThread();
+        renderThread->getRenderer()->restoreState(data);
+    }
+}
@@ -0,0 +1,353 @@
+#ifndef MEGANOSTALGIA_VDP_H
+#define MEGANOSTALGIA_VDP_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "Scheduler.h"
+
+class Memory;
+class VDPRenderThread;
+
+#define VDP_VRAM_SIZE 0x10000
+#define VDP_CRAM_SIZE 64
+#define VDP_VSRAM_SIZE 40
+#define VDP_REGISTER_COUNT 24
+#define VDP_TILE_COUNT 2048
+#define VDP_MAX_SPRITES 80
+#define VDP_MAX_SPRITES_PER_LINE 20
+
+// The framebuffer doesn't match any state of the VDP (e.g. after restoring a save state)
+#define VDP_NO_GENERATION UINT64_MAX
+
+#define VDP_SCREEN_WIDTH 320
+#define VDP_SCREEN_HEIGHT 224
+
+// Layer line buffers have a margin either side so partially visible tiles and sprites can be drawn without clipping
+#define VDP_LINE_BUFFER_MARGIN 32
+#define VDP_LINE_BUFFER_SIZE (VDP_SCREEN_WIDTH + VDP_LINE_BUFFER_MARGIN * 2)
+
+// Layer pixel format: bit 7 is the priority bit, bits 4-5 the palette line and bits 0-3 the colour (0 = transparent)
+#define VDP_PIXEL_PRIORITY 0x80
+#define VDP_PIXEL_COLOUR 0x0F
+#define VDP_PIXEL_CRAM_INDEX 0x3F
+
+enum VDPAccessCode {
+    VRAMRead = 0x0,
+    VRAMWrite = 0x1,
+    CRAMWrite = 0x3,
+    VSRAMRead = 0x4,
+    VSRAMWrite = 0x5,
+    CRAMRead = 0x8
+};
+
+/**
+ * A decoded sprite attribute table entry
+ */
+struct VDPSprite {
+    int y;
+    int x;
+    int widthCells;
+    int heightCells;
+    int link;
+    uint16_t attributes;
+};
+
+enum VDPPixelFormat {
+    XRGB8888,
+    RGB565,
+    Indexed8 // Bits 0-5 CRAM index, bits 6-7 shade (see VDPCompositor.h)
+};
+
+enum VDPWriteLogEntryType {
+    StartLine,
+    VRAMData,
+    CRAMData,
+    VSRAMData,
+    RegisterData
+};
+
+/**
+ * A change recorded for the render thread, in the order it happened. StartLine entries mark where each line begins.
+ * VRAMData entries have `value` bytes of data stored in the log's data buffer.
+ */
+struct VDPWriteLogEntry {
+    VDPWriteLogEntryType type;
+    uint16_t address;
+    uint32_t value;
+};
+
+struct VDPWriteLog {
+    std::vector<VDPWriteLogEntry> entries;
+    std::vector<unsigned char> data;
+};
+
+struct VDPSaveStateData {
+    unsigned char vram[VDP_VRAM_SIZE];
+    uint16_t cram[VDP_CRAM_SIZE];
+    uint16_t vsram[VDP_VSRAM_SIZE];
+    unsigned char registers[VDP_REGISTER_COUNT];
+    uint16_t address;
+    unsigned char code;
+    bool controlWritePending;
+    bool vIntPending;
+    bool spriteOverflow;
+    bool spriteCollision;
+    bool vBlank;
+    bool dmaFillPending;
+    int dmaSlotsRemaining;
+    int currentLine;
+    uint64_t nextLineTime;
+};
+
+static_assert(std::is_trivially_copyable<VDPSaveStateData>::value, "VDPSaveStateData must be trivially copyable");
+
+/**
+ * The Video Display Processor. Owns VRAM/CRAM/VSRAM, handles the control/data ports and renders one scanline at a
+ * time (driven by the scheduler's line events) into a 320x224 framebuffer, in XRGB8888, RGB565 or 8 bit indexed form.
+ */
+class VDP {
+public:
+
+    VDP();
+
+    ~VDP();
+
+    void setMemory(Memory *memory);
+
+    void reset();
+
+    uint16_t readData();
+
+    uint16_t readControl();
+
+    uint16_t readHVCounter();
+
+    void writeData(uint16_t value);
+
+    void writeControl(uint16_t value);
+
+    void setAccessClock(const uint64_t *masterClock);
+
+    void catchUp(uint64_t masterClock);
+
+    void startLine(int line);
+
+    void triggerVInt();
+
+    void setPAL(bool pal);
+
+    uint32_t takeM68kStallCycles();
+
+    void setPixelFormat(VDPPixelFormat format);
+
+    VDPPixelFormat getPixelFormat();
+
+    const unsigned char *getFramebuffer();
+
+    int getFramebufferPitch();
+
+    uint64_t getLinesRendered();
+
+    uint64_t getTilesDecoded();
+
+    uint64_t getFramesRendered();
+
+    uint64_t getFramesReused();
+
+    void setRenderSkipEnabled(bool enabled);
+
+    void setRenderThreaded(bool threaded);
+
+    bool isRenderThreaded();
+
+    void getSaveStateData(VDPSaveStateData &data);
+
+    void restoreState(const VDPSaveStateData &data);
+
+private:
+
+    friend class VDPRenderThread;
+
+    unsigned char vram[VDP_VRAM_SIZE];
+    uint16_t cram[VDP_CRAM_SIZE];
+    uint16_t vsram[VDP_VSRAM_SIZE];
+    unsigned char registers[VDP_REGISTER_COUNT];
+
+    // Control port state, commands are written as two 16 bit words
+    uint16_t address;
+    unsigned char code;
+    bool controlWritePending;
+
+    // Status flags
+    bool vIntPending;
+    bool spriteOverflow;
+    bool spriteCollision;
+    bool vBlank;
+
+    Memory *memory;
+    int currentLine;
+
+    // The VDP is only brought up to date when something needs it to be (port accesses, VINT, the end of a frame),
+    // lines that have started since then are run all at once. Port accesses catch up to the time in accessClock.
+    uint64_t nextLineTime;
+    const uint64_t *accessClock;
+
+    // H counter value at every master clock cycle of a line, [H40][cycle]. The counter skips over part of its range
+    // during horizontal blanking, so it's easier to look it up than to work it out on every read.
+    unsigned char hCounterTable[2][MASTER_CYCLES_PER_LINE];
+    bool pal;
+
+    // A VRAM fill starts on the next data port write. Fills and copies happen straight away, but the DMA busy flag
+    // stays set until enough access slots have passed.
+    bool dmaFillPending;
+    int dmaSlotsRemaining;
+
+    // Master clock cycles the 68k is frozen for by 68k to VDP transfers, collected by the emulator after each instruction
+    uint32_t m68kStallCycles;
+
+    VDPPixelFormat pixelFormat;
+    alignas(4) unsigned char framebuffer[VDP_SCREEN_WIDTH * VDP_SCREEN_HEIGHT * 4];
+
+    // Host colour of every 9 bit colour in each shade (normal, shadow, highlight), in the current pixel format
+    uint32_t colourLUT[3][512];
+
+    // Host colours for each CRAM entry and shade (indexed by output pixel), updated on CRAM writes
+    uint32_t palette[256];
+
+    // Every tile decoded to one byte per pixel, normal and horizontally flipped ([flipped][tile][row * 8 + column]).
+    // VRAM writes mark tiles as dirty and they are decoded again before the next line is rendered.
+    alignas(8) unsigned char tileCache[2][VDP_TILE_COUNT][64];
+    bool tileDirty[VDP_TILE_COUNT];
+    uint16_t dirtyTiles[VDP_TILE_COUNT];
+    int dirtyTileCount;
+    uint64_t tilesDecoded;
+
+    // Copy of the sprite attribute table, kept up to date by VRAM writes to it. The sprites on each line are only
+    // worked out again when a sprite's position, size or link (or the table address/screen mode) changes.
+    VDPSprite spriteTable[VDP_MAX_SPRITES];
+    uint16_t spriteTableAddress;
+    unsigned char lineSprites[VDP_SCREEN_HEIGHT][VDP_MAX_SPRITES_PER_LINE];
+    unsigned char lineSpriteCount[VDP_SCREEN_HEIGHT];
+    bool lineSpriteOverflow[VDP_SCREEN_HEIGHT];
+    bool spriteListsDirty;
+
+    unsigned char planeALine[VDP_LINE_BUFFER_SIZE];
+    unsigned char planeBLine[VDP_LINE_BUFFER_SIZE];
+    unsigned char spriteLine[VDP_LINE_BUFFER_SIZE];
+    unsigned char outputLine[VDP_SCREEN_WIDTH];
+
+    uint64_t linesRendered;
+
+    // Bumped by every change to VRAM, CRAM, VSRAM or the registers. If the whole framebuffer was drawn with the
+    // current generation (no mid frame changes) there is no need to draw it again.
+    uint64_t generation;
+    uint64_t framebufferGeneration;
+    uint64_t frameGeneration;
+    bool frameUniform;
+    bool renderSkipEnabled;
+    int frameLinesReused;
+    uint64_t framesRendered;
+    uint64_t framesReused;
+
+    // Sprite overflow (bit 0) and collision (bit 1) flags raised by each line, replayed when a line is reused
+    unsigned char lineSpriteStatus[VDP_SCREEN_HEIGHT];
+
+    // Threaded rendering. Changes are recorded in the active write log and handed to the render thread at the end of
+    // each frame, which replays them into its own copy of the VDP while the next frame is emulated.
+    VDPRenderThread *renderThread;
+    VDPWriteLog writeLogs[2];
+    int activeWriteLog;
+
+    void catchUpToAccess();
+
+    void buildHCounterTable();
+
+    uint16_t getVCounter();
+
+    int getLineCycle();
+
+    void writeRegister(int reg, unsigned char value);
+
+    void handleVRAMWrite(uint16_t vramAddress);
+
+    void handleVRAMRangeWrite(uint16_t vramAddress, uint32_t length);
+
+    void handleCRAMWrite(int index);
+
+    void handleVSRAMWrite(int index);
+
+    void markTileDirty(uint16_t vramAddress);
+
+    void markAllTilesDirty();
+
+    void updateTileCache();
+
+    void logWrite(VDPWriteLogEntryType type, uint16_t logAddress, uint32_t value);
+
+    void logVRAMWrite(uint16_t vramAddress, uint32_t length);
+
+    void submitWriteLog();
+
+    void syncRenderThread();
+
+    VDP *getRenderer();
+
+    void replayWriteLog(const VDPWriteLog &log);
+
+    void renderLine(int line);
+
+    void reuseLine(int line);
+
+    void updateSpriteStatus(int line);
+
+    void renderPlane(unsigned char *lineBuffer, uint16_t nameTableAddress, int line, bool planeB);
+
+    void renderWindow(unsigned char *lineBuffer, int line, int startX, int endX);
+
+    void drawTileRow(unsigned char *lineBuffer, uint16_t nameTableEntry, int row);
+
+    void startDMA();
+
+    void runM68kDMA();
+
+    void writeDMAWords(const unsigned char *source, uint32_t words);
+
+    void runFillDMA(uint16_t value);
+
+    void runCopyDMA();
+
+    uint32_t getDMALength();
+
+    void finishDMA(uint32_t slots);
+
+    uint32_t getDMACycles(uint32_t slots);
+
+    int getDMASlotsPerLine(int line);
+
+    void updateSpriteTable();
+
+    void updateSpriteTableEntry(int index);
+
+    void buildSpriteLists();
+
+    void renderSprites(int line);
+
+    void buildColourLUT();
+
+    uint32_t getHostColour(int red, int green, int blue);
+
+    void updatePaletteEntry(int index);
+
+    void writeLine(unsigned char *output, const unsigned char *pixels, int start, int end);
+
+    int getBytesPerPixel();
+
+    bool isH40Mode();
+
+    int getActiveWidth();
+
+    int getMaxSprites();
+};
+
+#endif //MEGANOSTALGIA_VDP_H
@@ -0,0 +1,279 @@
+#include "VDP.h"
+#include "VDPCompositor.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define VDP_COMPOSITOR_SSE2
+#endif
+
+// AVX2 is chosen at runtime so the default build still runs on CPUs without it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VDP_COMPOSITOR_AVX2
+
+static bool detectAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool avx2Supported = detectAVX2();
+#endif
+
+#ifdef VDP_COMPOSITOR_SSE2
+/**
+ * 16 pixels per step. Each layer's transparency and priority are turned into byte masks and the winning pixel is
+ * picked with and/andnot/or selects, following the same rules as composeScalar.
+ */
+static void composeSSE2(const unsigned char *planeA, const unsigned char *planeB, const unsigned char *sprites,
+                        unsigned char *output, int width, unsigned char backdrop, bool shadowHighlight) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char)0xFF);
+    const __m128i colourMask = _mm_set1_epi8(VDP_PIXEL_COLOUR);
+    const __m128i cramIndexMask = _mm_set1_epi8(VDP_PIXEL_CRAM_INDEX);
+    const __m128i backdropPixels = _mm_set1_epi8((char)backdrop);
+
+    for (int x = 0; x < width; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(planeA + x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(planeB + x));
+        __m128i s = _mm_loadu_si128((const __m128i *)(sprites + x));
+
+        // Priority is bit 7, so a signed compare against zero gives the priority mask
+        __m128i aPriority = _mm_cmplt_epi8(a, zero);
+        __m128i bPriority = _mm_cmplt_epi8(b, zero);
+        __m128i sPriority = _mm_cmplt_epi8(s, zero);
+        __m128i aTransparent = _mm_cmpeq_epi8(_mm_and_si128(a, colourMask), zero);
+        __m128i bTransparent = _mm_cmpeq_epi8(_mm_and_si128(b, colourMask), zero);
+        __m128i sTransparent = _mm_cmpeq_epi8(_mm_and_si128(s, colourMask), zero);
+
+        __m128i aHigh = _mm_andnot_si128(aTransparent, aPriority);
+        __m128i bHigh = _mm_andnot_si128(bTransparent, bPriority);
+        __m128i aWins = _mm_andnot_si128(_mm_or_si128(aTransparent, _mm_andnot_si128(aPriority, bHigh)), ones);
+        __m128i sWins = _mm_andnot_si128(_mm_or_si128(sTransparent, _mm_andnot_si128(sPriority, _mm_or_si128(aHigh, bHigh))), ones);
+
+        __m128i pixel = _mm_or_si128(_mm_and_si128(bTransparent, backdropPixels), _mm_andnot_si128(bTransparent, b));
+        pixel = _mm_or_si128(_mm_and_si128(aWins, a), _mm_andnot_si128(aWins, pixel));
+
+        if (!shadowHighlight) {
+            pixel = _mm_or_si128(_mm_and_si128(sWins, s), _mm_andnot_si128(sWins, pixel));
+            _mm_storeu_si128((__m128i *)(output + x), _mm_and_si128(pixel, cramIndexMask));
+            continue;
+        }
+
+        __m128i shadowed = _mm_cmpeq_epi8(_mm_or_si128(aPriority, bPriority), zero);
+        __m128i shade = _mm_and_si128(shadowed, _mm_set1_epi8(VDP_SHADE_SHADOW));
+
+        __m128i spriteIndex = _mm_and_si128(s, cramIndexMask);
+        __m128i highlightOperator = _mm_and_si128(sWins, _mm_cmpeq_epi8(spriteIndex, _mm_set1_epi8(0x3E)));
+        __m128i shadowOperator = _mm_and_si128(sWins, _mm_cmpeq_epi8(spriteIndex, _mm_set1_epi8(0x3F)));
+        __m128i spriteDrawn = _mm_andnot_si128(_mm_or_si128(highlightOperator, shadowOperator), sWins);
+        pixel = _mm_or_si128(_mm_and_si128(spriteDrawn, s), _mm_andnot_si128(spriteDrawn, pixel));
+
+        __m128i colour14 = _mm_cmpeq_epi8(_mm_and_si128(s, colourMask), _mm_set1_epi8(0x0E));
+        shade = _mm_andnot_si128(_mm_and_si128(spriteDrawn, _mm_or_si128(sPriority, colour14)), shade);
+        __m128i highlightShade = _mm_andnot_si128(shadowed, _mm_set1_epi8((char)VDP_SHADE_HIGHLIGHT));
+        shade = _mm_or_si128(_mm_and_si128(highlightOperator, highlightShade), _mm_andnot_si128(highlightOperator, shade));
+        shade = _mm_or_si128(_mm_and_si128(shadowOperator, _mm_set1_epi8(VDP_SHADE_SHADOW)), _mm_andnot_si128(shadowOperator, shade));
+
+        _mm_storeu_si128((__m128i *)(output + x), _mm_or_si128(_mm_and_si128(pixel, cramIndexMask), shade));
+    }
+}
+#endif
+
+#ifdef VDP_COMPOSITOR_AVX2
+/**
+ * The same as composeSSE2 but 32 pixels per step
+ */
+__attribute__((target("avx2")))
+static void composeAVX2(const unsigned char *planeA, const unsigned char *planeB, const unsigned char *sprites,
+                        unsigned char *output, int width, unsigned char backdrop, bool shadowHighlight) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8((char)0xFF);
+    const __m256i colourMask = _mm256_set1_epi8(VDP_PIXEL_COLOUR);
+    const __m256i cramIndexMask = _mm256_set1_epi8(VDP_PIXEL_CRAM_INDEX);
+    const __m256i backdropPixels = _mm256_set1_epi8((char)backdrop);
+
+    for (int x = 0; x < width; x += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(planeA + x));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(planeB + x));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(sprites + x));
+
+        __m256i aPriority = _mm256_cmpgt_epi8(zero, a);
+        __m256i bPriority = _mm256_cmpgt_epi8(zero, b);
+        __m256i sPriority = _mm256_cmpgt_epi8(zero, s);
+        __m256i aTransparent = _mm256_cmpeq_epi8(_mm256_and_si256(a, colourMask), zero);
+        __m256i bTransparent = _mm256_cmpeq_epi8(_mm256_and_si256(b, colourMask), zero);
+        __m256i sTransparent = _mm256_cmpeq_epi8(_mm256_and_si256(s, colourMask), zero);
+
+        __m256i aHigh = _mm256_andnot_si256(aTransparent, aPriority);
+        __m256i bHigh = _mm256_andnot_si256(bTransparent, bPriority);
+        __m256i aWins = _mm256_andnot_si256(_mm256_or_si256(aTransparent, _mm256_andnot_si256(aPriority, bHigh)), ones);
+        __m256i sWins = _mm256_andnot_si256(_mm256_or_si256(sTransparent, _mm256_andnot_si256(sPriority, _mm256_or_si256(aHigh, bHigh))), ones);
+
+        __m256i pixel = _mm256_blendv_epi8(b, backdropPixels, bTransparent);
+        pixel = _mm256_blendv_epi8(pixel, a, aWins);
+
+        if (!shadowHighlight) {
+            pixel = _mm256_blendv_epi8(pixel, s, sWins);
+            _mm256_storeu_si256((__m256i *)(output + x), _mm256_and_si256(pixel, cramIndexMask));
+            continue;
+        }
+
+        __m256i shadowed = _mm256_cmpeq_epi8(_mm256_or_si256(aPriority, bPriority), zero);
+        __m256i shade = _mm256_and_si256(shadowed, _mm256_set1_epi8(VDP_SHADE_SHADOW));
+
+        __m256i spriteIndex = _mm256_and_si256(s, cramIndexMask);
+        __m256i highlightOperator = _mm256_and_si256(sWins, _mm256_cmpeq_epi8(spriteIndex, _mm256_set1_epi8(0x3E)));
+        __m256i shadowOperator = _mm256_and_si256(sWins, _mm256_cmpeq_epi8(spriteIndex, _mm256_set1_epi8(0x3F)));
+        __m256i spriteDrawn = _mm256_andnot_si256(_mm256_or_si256(highlightOperator, shadowOperator), sWins);
+        pixel = _mm256_blendv_epi8(pixel, s, spriteDrawn);
+
+        __m256i colour14 = _mm256_cmpeq_epi8(_mm256_and_si256(s, colourMask), _mm256_set1_epi8(0x0E));
+        shade = _mm256_andnot_si256(_mm256_and_si256(spriteDrawn, _mm256_or_si256(sPriority, colour14)), shade);
+        __m256i highlightShade = _mm256_andnot_si256(shadowed, _mm256_set1_epi8((char)VDP_SHADE_HIGHLIGHT));
+        shade = _mm256_blendv_epi8(shade, highlightShade, highlightOperator);
+        shade = _mm256_blendv_epi8(shade, _mm256_set1_epi8(VDP_SHADE_SHADOW), shadowOperator);
+
+        _mm256_storeu_si256((__m256i *)(output + x), _mm256_or_si256(_mm256_and_si256(pixel, cramIndexMask), shade));
+    }
+}
+#endif
+
+static VDPCompositorImplementation getFastestImplementation() {
+#ifdef VDP_COMPOSITOR_AVX2
+    if (avx2Supported) {
+        return VDPCompositorImplementation::AVX2;
+    }
+#endif
+
+#ifdef VDP_COMPOSITOR_SSE2
+    return VDPCompositorImplementation::SSE2;
+#else
+    return VDPCompositorImplementation::Scalar;
+#endif
+}
+
+static VDPCompositorImplementation selectedImplementation = getFastestImplementation();
+
+/**
+ * [VDPCompositor::compose Composes a line with the selected implementation, the fastest available unless another has
+ * been chosen]
+ * @param width [Must be a multiple of 32 (256 or 320)]
+ */
+void VDPCompositor::compose(const unsigned char *planeA, const unsigned char *planeB, const unsigned char *sprites,
+                            unsigned char *output, int width, unsigned char backdrop, bool shadowHighlight) {
+    switch (selectedImplementation) {
+#ifdef VDP_COMPOSITOR_AVX2
+        case VDPCompositorImplementation::AVX2:
+            composeAVX2(planeA, planeB, sprites, output, width, backdrop, shadowHighlight);
+            break;
+#endif
+#ifdef VDP_COMPOSITOR_SSE2
+        case VDPCompositorImplementation::SSE2:
+            composeSSE2(planeA, planeB, sprites, output, width, backdrop, shadowHighlight);
+            break;
+#endif
+        default:
+            composeScalar(planeA, planeB, sprites, output, width, backdrop, shadowHighlight);
+            break;
+    }
+}
+
+/**
+ * [VDPCompositor::composeScalar One pixel at a time, the reference implementation]
+ */
+void VDPCompositor::composeScalar(const unsigned char *planeA, const unsigned char *planeB, const unsigned char *sprites,
+                                  unsigned char *output, int width, unsigned char backdrop, bool shadowHighlight) {
+    for (int x = 0; x < width; x++) {
+        unsigned char a = planeA[x];
+        unsigned char b = planeB[x];
+        unsigned char s = sprites[x];
+        unsigned char pixel = backdrop;
+        int layer = -1;
+
+        if (b & VDP_PIXEL_COLOUR) {
+            pixel = b;
+            layer = (b >> 7) * 3;
+        }
+
+        if ((a & VDP_PIXEL_COLOUR) && (a >> 7) * 3 + 1 > layer) {
+            pixel = a;
+            layer = (a >> 7) * 3 + 1;
+        }
+
+        bool spriteOnTop = (s & VDP_PIXEL_COLOUR) && (s >> 7) * 3 + 2 > layer;
+
+        if (!shadowHighlight) {
+            if (spriteOnTop) {
+                pixel = s;
+            }
+
+            output[x] = pixel & VDP_PIXEL_CRAM_INDEX;
+            continue;
+        }
+
+        // Priority counts even where the planes are transparent
+        unsigned char shade = ((a | b) & VDP_PIXEL_PRIORITY) ? VDP_SHADE_NORMAL : VDP_SHADE_SHADOW;
+
+        if (spriteOnTop) {
+            if ((s & VDP_PIXEL_CRAM_INDEX) == 0x3E) {
+                shade = shade == VDP_SHADE_SHADOW ? VDP_SHADE_NORMAL : VDP_SHADE_HIGHLIGHT;
+            } else if ((s & VDP_PIXEL_CRAM_INDEX) == 0x3F) {
+                shade = VDP_SHADE_SHADOW;
+            } else {
+                pixel = s;
+
+                // High priority sprites and colour 14 of the other palettes are never shadowed
+                if ((s & VDP_PIXEL_PRIORITY) || (s & VDP_PIXEL_COLOUR) == 0x0E) {
+                    shade = VDP_SHADE_NORMAL;
+                }
+            }
+        }
+
+        output[x] = (pixel & VDP_PIXEL_CRAM_INDEX) | shade;
+    }
+}
+
+/**
+ * Whether the implementation was built in and the CPU can run it
+ */
+bool VDPCompositor::isSupported(VDPCompositorImplementation implementation) {
+    switch (implementation) {
+#ifdef VDP_COMPOSITOR_AVX2
+        case VDPCompositorImplementation::AVX2:
+            return avx2Supported;
+#endif
+#ifdef VDP_COMPOSITOR_SSE2
+        case VDPCompositorImplementation::SSE2:
+            return true;
+#endif
+        case VDPCompositorImplementation::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Forces compose to use the given implementation, so each one can be checked against the scalar reference. Ignored if
+ * it isn't supported. Nothing may be composing at the time, including a render thread.
+ */
+void VDPCompositor::setImplementation(VDPCompositorImplementation implementation) {
+    if (isSupported(implementation)) {
+        selectedImplementation = implementation;
+    }
+}
+
+VDPCompositorImplementation VDPCompositor::getImplementation() {
+    return selectedImplementation;
+}
+
+const char *VDPCompositor::getImplementationName() {
+    switch (selectedImplementation) {
+        case VDPCompositorImplementation::AVX2:
+            return "AVX2";
+        case VDPCompositorImplementation::SSE2:
+            return "SSE2";
+        default:
+            return "Scalar";
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef MEGANOSTALGIA_VDPCOMPOSITOR_H
+#define MEGANOSTALGIA_VDPCOMPOSITOR_H
+
+#include <cstdint>
+
+// Output pixel format: bits 0-5 are the CRAM index, bits 6-7 the shade
+#define VDP_SHADE_NORMAL 0x00
+#define VDP_SHADE_SHADOW 0x40
+#define VDP_SHADE_HIGHLIGHT 0x80
+
+/**
+ * The versions of the compositor that can be built. Which ones are available depends on the build and the CPU.
+ */
+enum class VDPCompositorImplementation {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/**
+ * Merges the plane B, plane A (including the window) and sprite line buffers into a line of output pixels.
+ *
+ * From back to front the layers are: backdrop, plane B, plane A, sprites, then high priority plane B, plane A and
+ * sprites. In shadow/highlight mode pixels are shadowed unless plane A or B is high priority, and sprite pixels using
+ * palette 3 colours 14 and 15 highlight/shadow what is underneath rather than being drawn.
+ *
+ * The vectorised versions must produce exactly the same output as the scalar version.
+ */
+class VDPCompositor {
+public:
+    static void compose(const unsigned char *planeA, const unsigned char *planeB, const unsigned char *sprites,
+                        unsigned char *output, int width, unsigned char backdrop, bool shadowHighlight);
+
+    static void composeScalar(const unsigned char *planeA, const unsigned char *planeB, const unsigned char *sprites,
+                              unsigned char *output, int width, unsigned char backdrop, bool shadowHighlight);
+
+    static bool isSupported(VDPCompositorImplementation implementation);
+
+    static void setImplementation(VDPCompositorImplementation implementation);
+
+    static VDPCompositorImplementation getImplementation();
+
+    static const char *getImplementationName();
+};
+
+#endif //MEGANOSTALGIA_VDPCOMPOSITOR_H
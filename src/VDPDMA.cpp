@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cstring>
+#include "VDP.h"
+#include "Memory.h"
+#include "Scheduler.h"
+
+// DMA access slots per line, [H40][blanking]. A slot moves a byte of VRAM or a word of CRAM/VSRAM.
+static const int dmaSlotsPerLine[2][2] = {
+        {16, 167},
+        {18, 205}
+};
+
+/**
+ * Called once both control words have been written with CD5 set. Register 23 bits 6-7 select the type of DMA.
+ */
+void VDP::startDMA() {
+    switch (registers[23] & 0xC0) {
+        case 0x80:
+            // VRAM fill, starts with the next data port write
+            dmaFillPending = true;
+            break;
+        case 0xC0:
+            runCopyDMA();
+            break;
+        default:
+            runM68kDMA();
+            break;
+    }
+}
+
+/**
+ * Copies from 68k memory to VRAM, CRAM or VSRAM. The source is read straight from ROM/RAM in as few chunks as
+ * possible (the source address wraps at 128KB boundaries) rather than a bus access per word.
+ */
+void VDP::runM68kDMA() {
+    uint32_t length = getDMALength();
+    uint32_t source = ((registers[23] & 0x7F) << 17) | (registers[22] << 9) | (registers[21] << 1);
+
+    // The 68k is frozen until the transfer is done, VRAM takes 2 slots per word
+    m68kStallCycles += getDMACycles((code & 0x0F) == VDPAccessCode::VRAMWrite ? length * 2 : length);
+
+    while (length > 0) {
+        uint32_t available = 0;
+        const unsigned char *pointer = memory->getM68kReadPointer(source, available);
+        uint32_t words = std::min(length, (0x20000 - (source & 0x1FFFF)) >> 1);
+
+        if (pointer != nullptr && available >= 2) {
+            words = std::min(words, available >> 1);
+            writeDMAWords(pointer, words);
+        } else {
+            // Not plain memory, fall back to a normal bus read
+            uint16_t value = memory->m68kRead16Bit(source);
+            unsigned char bytes[2] = {(unsigned char)(value >> 8), (unsigned char)(value & 0xFF)};
+            words = 1;
+            writeDMAWords(bytes, 1);
+        }
+
+        source = (source & 0xFE0000) | ((source + words * 2) & 0x1FFFF);
+        length -= words;
+    }
+
+    registers[21] = (source >> 1) & 0xFF;
+    registers[22] = (source >> 9) & 0xFF;
+    finishDMA(0);
+}
+
+/**
+ * Writes big endian words to wherever the current access code points
+ */
+void VDP::writeDMAWords(const unsigned char *source, uint32_t words) {
+    switch (code & 0x0F) {
+        case VDPAccessCode::VRAMWrite: {
+            uint16_t startAddress = address;
+
+            if (registers[15] == 2 && !(address & 1)) {
+                // Contiguous, so copied in chunks that each stop at the end of VRAM. A full length transfer is twice
+                // the size of VRAM, so it can wrap around more than once.
+                uint32_t bytes = words * 2;
+                bool changed = false;
+
+                for (uint32_t copied = 0; copied < bytes;) {
+                    uint32_t chunk = std::min(bytes - copied, (uint32_t)(VDP_VRAM_SIZE - address));
+
+                    // Sprite tables and the like are often sent every frame unchanged, only real changes need the
+                    // caches updating
+                    if (memcmp(&vram[address], source + copied, chunk) != 0) {
+                        memcpy(&vram[address], source + copied, chunk);
+                        changed = true;
+                    }
+
+                    address += chunk;
+                    copied += chunk;
+                }
+
+                if (changed) {
+                    handleVRAMRangeWrite(startAddress, std::min(bytes, (uint32_t)VDP_VRAM_SIZE));
+                }
+                break;
+            }
+
+            for (uint32_t i = 0; i < words; i++, source += 2) {
+                unsigned char high = source[0];
+                unsigned char low = source[1];
+
+                if (address & 1) {
+                    std::swap(high, low);
+                }
+
+                vram[address & 0xFFFE] = high;
+                vram[address | 1] = low;
+                handleVRAMWrite(address);
+                address += registers[15];
+            }
+            break;
+        }
+        case VDPAccessCode::CRAMWrite:
+            for (uint32_t i = 0; i < words; i++, source += 2) {
+                uint16_t colour = ((source[0] << 8) | source[1]) & 0x0EEE;
+
+                if (cram[(address >> 1) & 0x3F] != colour) {
+                    cram[(address >> 1) & 0x3F] = colour;
+                    handleCRAMWrite((address >> 1) & 0x3F);
+                }
+                address += registers[15];
+            }
+            break;
+        case VDPAccessCode::VSRAMWrite:
+            for (uint32_t i = 0; i < words; i++, source += 2) {
+                if (((address >> 1) & 0x3F) < VDP_VSRAM_SIZE) {
+                    vsram[(address >> 1) & 0x3F] = ((source[0] << 8) | source[1]) & 0x07FF;
+                    handleVSRAMWrite((address >> 1) & 0x3F);
+                }
+                address += registers[15];
+            }
+            break;
+        default:
+            address += registers[15] * words;
+            break;
+    }
+}
+
+/**
+ * Fills VRAM with the high byte of the data port write that started it (CRAM/VSRAM get the whole word)
+ */
+void VDP::runFillDMA(uint16_t value) {
+    uint32_t length = getDMALength();
+    uint16_t startAddress = address;
+    dmaFillPending = false;
+
+    switch (code & 0x0F) {
+        case VDPAccessCode::VRAMWrite: {
+            unsigned char data = value >> 8;
+
+            for (uint32_t i = 0; i < length; i++) {
+                vram[address ^ 1] = data;
+                address += registers[15];
+            }
+
+            handleVRAMRangeWrite(startAddress & 0xFFFE, std::min(length * std::max((int)registers[15], 1) + 2, (uint32_t)VDP_VRAM_SIZE));
+            break;
+        }
+        case VDPAccessCode::CRAMWrite:
+            for (uint32_t i = 0; i < length; i++) {
+                cram[(address >> 1) & 0x3F] = value & 0x0EEE;
+                handleCRAMWrite((address >> 1) & 0x3F);
+                address += registers[15];
+            }
+            break;
+        case VDPAccessCode::VSRAMWrite:
+            for (uint32_t i = 0; i < length; i++) {
+                if (((address >> 1) & 0x3F) < VDP_VSRAM_SIZE) {
+                    vsram[(address >> 1) & 0x3F] = value & 0x07FF;
+                    handleVSRAMWrite((address >> 1) & 0x3F);
+                }
+                address += registers[15];
+            }
+            break;
+        default:
+            break;
+    }
+
+    finishDMA(length);
+}
+
+/**
+ * Copies bytes within VRAM, the source address is in registers 21 and 22
+ */
+void VDP::runCopyDMA() {
+    uint32_t length = getDMALength();
+    uint16_t source = registers[21] | (registers[22] << 8);
+    uint16_t startAddress = address;
+
+    for (uint32_t i = 0; i < length; i++) {
+        vram[address] = vram[source++];
+        address += registers[15];
+    }
+
+    handleVRAMRangeWrite(startAddress, std::min(length * std::max((int)registers[15], 1), (uint32_t)VDP_VRAM_SIZE));
+
+    registers[21] = source & 0xFF;
+    registers[22] = source >> 8;
+
+    // Copies read and write each byte
+    finishDMA(length * 2);
+}
+
+/**
+ * Length in words for 68k transfers, bytes for fills and copies. 0 means 0x10000.
+ */
+uint32_t VDP::getDMALength() {
+    uint32_t length = registers[19] | (registers[20] << 8);
+    return length == 0 ? 0x10000 : length;
+}
+
+/**
+ * @param slots - Access slots used by a fill or copy, the DMA busy flag stays set until they have passed
+ */
+void VDP::finishDMA(uint32_t slots) {
+    registers[19] = 0;
+    registers[20] = 0;
+    dmaSlotsRemaining += slots;
+}
+
+/**
+ * How many master clock cycles it takes to get through a number of access slots, starting from the current line
+ */
+uint32_t VDP::getDMACycles(uint32_t slots) {
+    uint32_t cycles = 0;
+    int line = currentLine;
+
+    while (true) {
+        uint32_t lineSlots = getDMASlotsPerLine(line);
+
+        if (slots <= lineSlots) {
+            return cycles + slots * MASTER_CYCLES_PER_LINE / lineSlots;
+        }
+
+        slots -= lineSlots;
+        cycles += MASTER_CYCLES_PER_LINE;
+        line = (line + 1) % LINES_PER_FRAME;
+    }
+}
+
+/**
+ * Many more slots are free for DMA while the display isn't being drawn
+ */
+int VDP::getDMASlotsPerLine(int line) {
+    bool blanking = line >= VDP_SCREEN_HEIGHT || !(registers[1] & 0x40);
+    return dmaSlotsPerLine[isH40Mode()][blanking];
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cstring>
+#include "VDPRenderThread.h"
+
+/**
+ * @param renderer - The VDP copy that logs are replayed into, owned by the render thread from now on
+ */
+VDPRenderThread::VDPRenderThread(VDP *renderer) {
+    this->renderer = renderer;
+    pendingLog = nullptr;
+    stopping = false;
+    thread = std::thread(&VDPRenderThread::run, this);
+}
+
+VDPRenderThread::~VDPRenderThread() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    condition.notify_all();
+    thread.join();
+    delete renderer;
+}
+
+/**
+ * Only safe to use from the emulation thread while the render thread is idle (see waitUntilIdle)
+ */
+VDP *VDPRenderThread::getRenderer() {
+    return renderer;
+}
+
+/**
+ * Hands a log over to be replayed, after waiting for the previous one to finish. The log must not be changed until
+ * the next call to submit or waitUntilIdle returns.
+ */
+void VDPRenderThread::submit(const VDPWriteLog *log) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return pendingLog == nullptr; });
+    pendingLog = log;
+    condition.notify_all();
+}
+
+void VDPRenderThread::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return pendingLog == nullptr; });
+}
+
+void VDPRenderThread::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        condition.wait(lock, [this] { return pendingLog != nullptr || stopping; });
+
+        if (pendingLog == nullptr) {
+            return;
+        }
+
+        const VDPWriteLog *log = pendingLog;
+        lock.unlock();
+
+        renderer->replayWriteLog(*log);
+
+        lock.lock();
+        pendingLog = nullptr;
+        condition.notify_all();
+    }
+}
+
+/**
+ * Moves rendering onto a separate thread, or back onto this one. The render thread starts with a copy of this VDP
+ * (caches and framebuffer included) so nothing needs drawing again when switching either way. The copy only replays
+ * logs, so it is cut off from the bus and the emulation's clock.
+ */
+void VDP::setRenderThreaded(bool threaded) {
+    if (threaded == (renderThread != nullptr)) {
+        return;
+    }
+
+    if (threaded) {
+        writeLogs[0].entries.clear();
+        writeLogs[0].data.clear();
+        activeWriteLog = 0;
+
+        VDP *renderer = new VDP(*this);
+        renderer->memory = nullptr;
+        renderer->accessClock = nullptr;
+        renderer->writeLogs[0] = VDPWriteLog();
+        renderer->writeLogs[1] = VDPWriteLog();
+        renderThread = new VDPRenderThread(renderer);
+        return;
+    }
+
+    syncRenderThread();
+
+    VDP *renderer = renderThread->getRenderer();
+    memcpy(framebuffer, renderer->framebuffer, sizeof(framebuffer));
+    memcpy(lineSpriteStatus, renderer->lineSpriteStatus, sizeof(lineSpriteStatus));
+    linesRendered = renderer->linesRendered;
+    tilesDecoded = renderer->tilesDecoded;
+    framesRendered = renderer->framesRendered;
+    framesReused = renderer->framesReused;
+
+    // The generations of the two copies don't match
+    framebufferGeneration = VDP_NO_GENERATION;
+
+    delete renderThread;
+    renderThread = nullptr;
+}
+
+bool VDP::isRenderThreaded() {
+    return renderThread != nullptr;
+}
+
+void VDP::logWrite(VDPWriteLogEntryType type, uint16_t logAddress, uint32_t value) {
+    writeLogs[activeWriteLog].entries.push_back({type, logAddress, value});
+}
+
+/**
+ * Records the new contents of a range of VRAM (wrapping at the end)
+ */
+void VDP::logVRAMWrite(uint16_t vramAddress, uint32_t length) {
+    VDPWriteLog &log = writeLogs[activeWriteLog];
+    uint32_t firstPart = std::min(length, (uint32_t)(VDP_VRAM_SIZE - vramAddress));
+
+    log.entries.push_back({VDPWriteLogEntryType::VRAMData, vramAddress, length});
+    log.data.insert(log.data.end(), &vram[vramAddress], &vram[vramAddress] + firstPart);
+    log.data.insert(log.data.end(), vram, vram + (length - firstPart));
+}
+
+/**
+ * Hands the active log to the render thread and starts recording into the other one, which the render thread has
+ * finished with once submit returns
+ */
+void VDP::submitWriteLog() {
+    renderThread->submit(&writeLogs[activeWriteLog]);
+    activeWriteLog ^= 1;
+    writeLogs[activeWriteLog].entries.clear();
+    writeLogs[activeWriteLog].data.clear();
+}
+
+/**
+ * Hands over everything recorded so far and waits for it to be drawn, then copies the result into this VDP's own
+ * framebuffer. The render thread only ever draws into its copy, so what getFramebuffer returns stays put until the
+ * next sync.
+ */
+void VDP::syncRenderThread() {
+    submitWriteLog();
+    renderThread->waitUntilIdle();
+    memcpy(framebuffer, renderThread->getRenderer()->framebuffer, sizeof(framebuffer));
+}
+
+/**
+ * The VDP that draws the framebuffer, after waiting for it to catch up if it is on another thread
+ */
+VDP *VDP::getRenderer() {
+    if (renderThread == nullptr) {
+        return this;
+    }
+
+    syncRenderThread();
+    return renderThread->getRenderer();
+}
+
+/**
+ * Applies recorded changes in order, drawing each line when its StartLine entry is reached
+ */
+void VDP::replayWriteLog(const VDPWriteLog &log) {
+    const unsigned char *data = log.data.data();
+
+    for (const VDPWriteLogEntry &entry : log.entries) {
+        switch (entry.type) {
+            case VDPWriteLogEntryType::StartLine:
+                startLine(entry.address);
+                break;
+            case VDPWriteLogEntryType::VRAMData: {
+                uint32_t firstPart = std::min(entry.value, (uint32_t)(VDP_VRAM_SIZE - entry.address));
+                memcpy(&vram[entry.address], data, firstPart);
+                memcpy(vram, data + firstPart, entry.value - firstPart);
+                data += entry.value;
+
+                if (entry.value == 2) {
+                    handleVRAMWrite(entry.address);
+                } else {
+                    handleVRAMRangeWrite(entry.address, entry.value);
+                }
+                break;
+            }
+            case VDPWriteLogEntryType::CRAMData:
+                cram[entry.address] = entry.value;
+                handleCRAMWrite(entry.address);
+                break;
+            case VDPWriteLogEntryType::VSRAMData:
+                vsram[entry.address] = entry.value;
+                handleVSRAMWrite(entry.address);
+                break;
+            case VDPWriteLogEntryType::RegisterData:
+                writeRegister(entry.address, entry.value);
+                break;
+        }
+    }
+}
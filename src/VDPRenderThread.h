@@ -0,0 +1,38 @@
+#ifndef MEGANOSTALGIA_VDPRENDERTHREAD_H
+#define MEGANOSTALGIA_VDPRENDERTHREAD_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "VDP.h"
+
+/**
+ * Replays VDP write logs into its own copy of the VDP on a separate thread, so a frame can be drawn while the next one
+ * is emulated. Only one log is in flight at a time, handing over another waits for the previous one to be drawn.
+ */
+class VDPRenderThread {
+public:
+
+    explicit VDPRenderThread(VDP *renderer);
+
+    ~VDPRenderThread();
+
+    VDP *getRenderer();
+
+    void submit(const VDPWriteLog *log);
+
+    void waitUntilIdle();
+
+private:
+
+    VDP *renderer;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    const VDPWriteLog *pendingLog;
+    bool stopping;
+
+    void run();
+};
+
+#endif //MEGANOSTALGIA_VDPRENDERTHREAD_H
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cstring>
+#include "VDP.h"
+#include "VDPCompositor.h"
+
+// Plane sizes in cells, indexed by the 2 bit size fields in register 16 (0b10 is invalid, treated as 32)
+static const int planeSizes[4] = {32, 64, 32, 128};
+
+/**
+ * Renders a single line into the framebuffer. Each layer is drawn a whole tile row at a time into its own line
+ * buffer, then the layers are composed and converted to host colours in a single pass.
+ */
+void VDP::renderLine(int line) {
+    int width = getActiveWidth();
+    unsigned char *output = &framebuffer[line * getFramebufferPitch()];
+    unsigned char backdrop = registers[7] & 0x3F;
+
+    if (dirtyTileCount > 0) {
+        updateTileCache();
+    }
+
+    if (!(registers[1] & 0x40)) {
+        // Display disabled, only the backdrop colour is shown
+        lineSpriteStatus[line] = 0;
+        memset(outputLine, backdrop, VDP_SCREEN_WIDTH);
+        writeLine(output, outputLine, 0, VDP_SCREEN_WIDTH);
+        linesRendered++;
+        return;
+    }
+
+    // The window replaces plane A either for the whole line or for a range of 16 pixel columns
+    int windowStart = 0;
+    int windowEnd = 0;
+    int windowLine = (registers[18] & 0x1F) * 8;
+
+    if ((registers[18] & 0x80) ? line >= windowLine : line < windowLine) {
+        windowEnd = width;
+    } else {
+        int windowColumn = std::min((registers[17] & 0x1F) * 16, width);
+
+        if (registers[17] & 0x80) {
+            windowStart = windowColumn;
+            windowEnd = width;
+        } else {
+            windowEnd = windowColumn;
+        }
+    }
+
+    if (windowStart > 0 || windowEnd < width) {
+        renderPlane(planeALine, (registers[2] & 0x38) << 10, line, false);
+    }
+
+    if (windowEnd > windowStart) {
+        renderWindow(planeALine, line, windowStart, windowEnd);
+    }
+
+    renderPlane(planeBLine, (registers[4] & 0x07) << 13, line, true);
+    renderSprites(line);
+
+    VDPCompositor::compose(planeALine + VDP_LINE_BUFFER_MARGIN, planeBLine + VDP_LINE_BUFFER_MARGIN,
+                           spriteLine + VDP_LINE_BUFFER_MARGIN, outputLine, width, backdrop,
+                           registers[12] & 0x08);
+
+    // H32 mode only uses the left 256 pixels of the framebuffer
+    memset(outputLine + width, backdrop, VDP_SCREEN_WIDTH - width);
+    writeLine(output, outputLine, 0, VDP_SCREEN_WIDTH);
+
+    linesRendered++;
+}
+
+/**
+ * Draws one line of a scrolling plane into a layer line buffer, a tile row (8 pixels) at a time
+ * @param lineBuffer
+ * @param nameTableAddress
+ * @param line - Screen line
+ * @param planeB - Plane B uses the second of each pair of scroll values
+ */
+void VDP::renderPlane(unsigned char *lineBuffer, uint16_t nameTableAddress, int line, bool planeB) {
+    int width = getActiveWidth();
+    int planeWidthCells = planeSizes[registers[16] & 0x03];
+    int planeHeightMask = planeSizes[(registers[16] >> 4) & 0x03] * 8 - 1;
+
+    // Horizontal scroll is either for the whole screen, per 8 lines or per line
+    uint16_t hScrollAddress = (registers[13] & 0x3F) << 10;
+
+    switch (registers[11] & 0x03) {
+        case 1:
+            hScrollAddress += (line & 0x07) * 4;
+            break;
+        case 2:
+            hScrollAddress += (line & ~0x07) * 4;
+            break;
+        case 3:
+            hScrollAddress += line * 4;
+            break;
+        default:
+            break;
+    }
+
+    if (planeB) {
+        hScrollAddress += 2;
+    }
+
+    int hScroll = ((vram[hScrollAddress] << 8) | vram[hScrollAddress + 1]) & 0x3FF;
+    int planeX = -hScroll & (planeWidthCells * 8 - 1);
+    int fineX = planeX & 0x07;
+    int column = planeX >> 3;
+
+    // Vertical scroll is either for the whole screen or per 16 pixel column
+    bool columnVScroll = registers[11] & 0x04;
+    int vScroll = vsram[planeB ? 1 : 0];
+
+    unsigned char *output = lineBuffer + VDP_LINE_BUFFER_MARGIN - fineX;
+    int tiles = (width >> 3) + 1;
+
+    for (int tile = 0; tile < tiles; tile++, output += 8) {
+        if (columnVScroll) {
+            int screenColumn = std::max(tile * 8 - fineX, 0) >> 4;
+            vScroll = vsram[screenColumn * 2 + (planeB ? 1 : 0)];
+        }
+
+        int y = (line + vScroll) & planeHeightMask;
+        uint16_t entryAddress = nameTableAddress + (((y >> 3) * planeWidthCells + ((column + tile) & (planeWidthCells - 1))) << 1);
+        uint16_t entry = (vram[entryAddress] << 8) | vram[entryAddress | 1];
+
+        drawTileRow(output, entry, y & 0x07);
+    }
+}
+
+/**
+ * Draws the window (a non-scrolling plane) over plane A between startX and endX
+ */
+void VDP::renderWindow(unsigned char *lineBuffer, int line, int startX, int endX) {
+    int windowWidthCells = isH40Mode() ? 64 : 32;
+    uint16_t nameTableAddress = (registers[3] & (isH40Mode() ? 0x3C : 0x3E)) << 10;
+    uint16_t rowAddress = nameTableAddress + (((line >> 3) * windowWidthCells) << 1);
+
+    for (int x = startX; x < endX; x += 8) {
+        uint16_t entryAddress = rowAddress + ((x >> 3) << 1);
+        uint16_t entry = (vram[entryAddress] << 8) | vram[entryAddress | 1];
+
+        drawTileRow(lineBuffer + VDP_LINE_BUFFER_MARGIN + x, entry, line & 0x07);
+    }
+}
+
+/**
+ * Copies 8 pre-decoded pixels of a tile into a line buffer, adding the priority and palette bits
+ * @param lineBuffer
+ * @param nameTableEntry - Priority (bit 15), palette (13-14), vertical flip (12), horizontal flip (11), tile (0-10)
+ * @param row - Row within the tile, before flipping
+ */
+void VDP::drawTileRow(unsigned char *lineBuffer, uint16_t nameTableEntry, int row) {
+    uint64_t attributes = ((nameTableEntry >> 8) & VDP_PIXEL_PRIORITY) | ((nameTableEntry >> 9) & 0x30);
+
+    if (nameTableEntry & 0x1000) {
+        row = 7 - row;
+    }
+
+    uint64_t pixels;
+    memcpy(&pixels, &tileCache[(nameTableEntry >> 11) & 1][nameTableEntry & 0x07FF][row << 3], 8);
+    pixels |= attributes * 0x0101010101010101ULL;
+    memcpy(lineBuffer, &pixels, 8);
+}
+
+/**
+ * Decodes every tile that has been written to since it was last decoded. Tiles are 4 bits per pixel, 4 bytes per
+ * row, with the leftmost pixel in the high nibble.
+ */
+void VDP::updateTileCache() {
+    for (int i = 0; i < dirtyTileCount; i++) {
+        uint16_t tile = dirtyTiles[i];
+        const unsigned char *pattern = &vram[tile << 5];
+        unsigned char *normal = tileCache[0][tile];
+        unsigned char *flipped = tileCache[1][tile];
+
+        for (int row = 0; row < 8; row++, pattern += 4, normal += 8, flipped += 8) {
+            for (int pair = 0; pair < 4; pair++) {
+                normal[pair * 2] = flipped[7 - pair * 2] = pattern[pair] >> 4;
+                normal[pair * 2 + 1] = flipped[6 - pair * 2] = pattern[pair] & 0x0F;
+            }
+        }
+
+        tileDirty[tile] = false;
+    }
+
+    tilesDecoded += dirtyTileCount;
+    dirtyTileCount = 0;
+}
+
+/**
+ * Re-reads the whole sprite attribute table, after its address or the screen mode has changed
+ */
+void VDP::updateSpriteTable() {
+    spriteTableAddress = (registers[5] & (isH40Mode() ? 0x7E : 0x7F)) << 9;
+
+    for (int index = 0; index < VDP_MAX_SPRITES; index++) {
+        updateSpriteTableEntry(index);
+    }
+
+    spriteListsDirty = true;
+}
+
+void VDP::updateSpriteTableEntry(int index) {
+    const unsigned char *entry = &vram[(uint16_t)(spriteTableAddress + (index << 3))];
+    VDPSprite &sprite = spriteTable[index];
+    // Bit 9 is only used in double resolution interlace, which isn't supported
+    int y = (((entry[0] << 8) | entry[1]) & 0x1FF) - 128;
+    int heightCells = (entry[2] & 0x03) + 1;
+    int widthCells = ((entry[2] >> 2) & 0x03) + 1;
+    int link = entry[3] & 0x7F;
+
+    // Only changes to the position, size or link can change which sprites are on each line
+    if (y != sprite.y || heightCells != sprite.heightCells || widthCells != sprite.widthCells || link != sprite.link) {
+        spriteListsDirty = true;
+    }
+
+    sprite.y = y;
+    sprite.heightCells = heightCells;
+    sprite.widthCells = widthCells;
+    sprite.link = link;
+    sprite.attributes = (entry[4] << 8) | entry[5];
+    sprite.x = ((entry[6] << 8) | entry[7]) & 0x1FF;
+}
+
+/**
+ * Walks the sprite table's linked list once and adds each sprite to the lines it covers, in list order. Lines which
+ * would have more than the per line limit are flagged as overflowing.
+ */
+void VDP::buildSpriteLists() {
+    int maxSprites = getMaxSprites();
+    int maxSpritesPerLine = isH40Mode() ? 20 : 16;
+    int index = 0;
+
+    memset(lineSpriteCount, 0, sizeof(lineSpriteCount));
+    memset(lineSpriteOverflow, 0, sizeof(lineSpriteOverflow));
+
+    for (int i = 0; i < maxSprites; i++) {
+        const VDPSprite &sprite = spriteTable[index];
+        int firstLine = std::max(sprite.y, 0);
+        int lastLine = std::min(sprite.y + sprite.heightCells * 8, VDP_SCREEN_HEIGHT);
+
+        for (int line = firstLine; line < lastLine; line++) {
+            if (lineSpriteCount[line] == maxSpritesPerLine) {
+                lineSpriteOverflow[line] = true;
+                continue;
+            }
+
+            lineSprites[line][lineSpriteCount[line]++] = index;
+        }
+
+        if (sprite.link == 0 || sprite.link >= maxSprites) {
+            break;
+        }
+
+        index = sprite.link;
+    }
+
+    spriteListsDirty = false;
+}
+
+/**
+ * Draws the sprites on the line, earlier sprites in the list are drawn in front of later ones. Obeys the dot limit.
+ */
+void VDP::renderSprites(int line) {
+    memset(spriteLine, 0, sizeof(spriteLine));
+
+    if (spriteListsDirty) {
+        buildSpriteLists();
+    }
+
+    int width = getActiveWidth();
+    int dots = 0;
+    bool nonZeroXFound = false;
+    bool masked = false;
+    bool overflow = lineSpriteOverflow[line];
+    bool collision = false;
+
+    for (int i = 0; i < lineSpriteCount[line]; i++) {
+        const VDPSprite &sprite = spriteTable[lineSprites[line][i]];
+
+        // A sprite at X position 0 hides any later sprites on the line, unless it is the first to be found and the
+        // previous line didn't overflow
+        if (sprite.x == 0) {
+            masked = masked || nonZeroXFound || (line > 0 && lineSpriteOverflow[line - 1]);
+        } else {
+            nonZeroXFound = true;
+        }
+
+        // Once the dot limit is reached the rest of the sprite isn't drawn (sprites are always whole cells wide)
+        int cellsToDraw = std::min(sprite.widthCells, (width - dots) >> 3);
+        dots += cellsToDraw * 8;
+
+        if (!masked) {
+            int spriteRow = line - sprite.y;
+
+            if (sprite.attributes & 0x1000) {
+                spriteRow = sprite.heightCells * 8 - 1 - spriteRow;
+            }
+
+            unsigned char pixelAttributes = ((sprite.attributes >> 8) & VDP_PIXEL_PRIORITY) | ((sprite.attributes >> 9) & 0x30);
+            bool hFlip = sprite.attributes & 0x0800;
+            int x = sprite.x - 128;
+
+            for (int cell = 0; cell < cellsToDraw; cell++, x += 8) {
+                if (x <= -8 || x >= width) {
+                    continue;
+                }
+
+                // Sprite tiles are arranged in columns
+                int sourceCell = hFlip ? sprite.widthCells - 1 - cell : cell;
+                int tile = ((sprite.attributes & 0x07FF) + sourceCell * sprite.heightCells + (spriteRow >> 3)) & 0x07FF;
+                const unsigned char *pixels = &tileCache[hFlip][tile][(spriteRow & 0x07) << 3];
+                unsigned char *output = spriteLine + VDP_LINE_BUFFER_MARGIN + x;
+
+                for (int pixel = 0; pixel < 8; pixel++) {
+                    unsigned char colour = pixels[pixel];
+
+                    if (!colour) {
+                        continue;
+                    }
+
+                    if (output[pixel] & VDP_PIXEL_COLOUR) {
+                        if (x + pixel >= 0 && x + pixel < width) {
+                            collision = true;
+                        }
+                        continue;
+                    }
+
+                    output[pixel] = pixelAttributes | colour;
+                }
+            }
+        }
+
+        if (dots >= width) {
+            overflow = true;
+            break;
+        }
+    }
+
+    lineSpriteStatus[line] = overflow | (collision << 1);
+    spriteOverflow |= overflow;
+    spriteCollision |= collision;
+}
+
+/**
+ * Sets the sprite flags the line raises without drawing it, for when the render thread draws it later. Only a line
+ * with more than one sprite on it can have a collision, so the sprite pixels are only worked out for those.
+ */
+void VDP::updateSpriteStatus(int line) {
+    if (!(registers[1] & 0x40)) {
+        lineSpriteStatus[line] = 0;
+        return;
+    }
+
+    if (spriteListsDirty) {
+        buildSpriteLists();
+    }
+
+    if (lineSpriteCount[line] < 2) {
+        lineSpriteStatus[line] = lineSpriteOverflow[line];
+        spriteOverflow |= lineSpriteOverflow[line];
+        return;
+    }
+
+    if (dirtyTileCount > 0) {
+        updateTileCache();
+    }
+
+    renderSprites(line);
+}
+
+/**
+ * Converts composed pixels (CRAM index and shade) to the framebuffer's pixel format
+ */
+void VDP::writeLine(unsigned char *output, const unsigned char *pixels, int start, int end) {
+    switch (pixelFormat) {
+        case VDPPixelFormat::XRGB8888:
+            for (int x = start; x < end; x++) {
+                ((uint32_t *)output)[x] = palette[pixels[x]];
+            }
+            break;
+        case VDPPixelFormat::RGB565:
+            for (int x = start; x < end; x++) {
+                ((uint16_t *)output)[x] = (uint16_t)palette[pixels[x]];
+            }
+            break;
+        case VDPPixelFormat::Indexed8:
+            memcpy(output + start, pixels + start, end - start);
+            break;
+    }
+}
+
+/**
+ * Works out the host colour of every 9 bit colour (----BBB-GGG-RRR- in CRAM) in normal, shadowed (half brightness)
+ * and highlighted (half brightness plus half) form, only needed when the pixel format changes
+ */
+void VDP::buildColourLUT() {
+    for (int colour = 0; colour < 512; colour++) {
+        int red = colour & 0x07;
+        int green = (colour >> 3) & 0x07;
+        int blue = colour >> 6;
+
+        // Each component has 15 levels, normal colours use the even ones
+        colourLUT[0][colour] = getHostColour(red * 2, green * 2, blue * 2);
+        colourLUT[1][colour] = getHostColour(red, green, blue);
+        colourLUT[2][colour] = getHostColour(red + 7, green + 7, blue + 7);
+    }
+}
+
+/**
+ * @param red - 0 to 14
+ * @param green - 0 to 14
+ * @param blue - 0 to 14
+ */
+uint32_t VDP::getHostColour(int red, int green, int blue) {
+    if (pixelFormat == VDPPixelFormat::RGB565) {
+        return ((red * 31 / 14) << 11) | ((green * 63 / 14) << 5) | (blue * 31 / 14);
+    }
+
+    return ((red * 255 / 14) << 16) | ((green * 255 / 14) << 8) | (blue * 255 / 14);
+}
+
+void VDP::updatePaletteEntry(int index) {
+    generation++;
+
+    int colour = ((cram[index] >> 1) & 0x07) | ((cram[index] >> 2) & 0x38) | ((cram[index] >> 3) & 0x1C0);
+
+    palette[VDP_SHADE_NORMAL | index] = colourLUT[0][colour];
+    palette[VDP_SHADE_SHADOW | index] = colourLUT[1][colour];
+    palette[VDP_SHADE_HIGHLIGHT | index] = colourLUT[2][colour];
+}
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstdio>
+#include "VGMPlayer.h"
+#include "VGMWriter.h"
+#include "Exceptions.h"
+#include "Scheduler.h"
+
+#ifdef MEGANOSTALGIA_ZLIB
+#include <zlib.h>
+#endif
+
+// Files are read in blocks of this size, the length of a compressed file isn't known up front
+#define VGM_PLAYER_READ_SIZE 65536
+
+// Before version 1.50 the data always starts straight after the original 0x40 byte header
+#define VGM_PLAYER_OLD_DATA_START 0x40
+
+/**
+ * Loads the whole file. VGZ files are decompressed as they are read.
+ */
+VGMPlayer::VGMPlayer(const std::string &fileName) {
+#ifdef MEGANOSTALGIA_ZLIB
+    // Reads uncompressed files as they are
+    gzFile file = gzopen(fileName.c_str(), "rb");
+#else
+    FILE *file = fopen(fileName.c_str(), "rb");
+#endif
+
+    if (file == nullptr) {
+        throw IOException(Utils::implodeString({"Unable to open VGM file '", fileName, "'"}));
+    }
+
+    size_t length = 0;
+    int read;
+
+    do {
+        data.resize(length + VGM_PLAYER_READ_SIZE);
+#ifdef MEGANOSTALGIA_ZLIB
+        read = gzread(file, &data[length], VGM_PLAYER_READ_SIZE);
+#else
+        read = (int)fread(&data[length], 1, VGM_PLAYER_READ_SIZE, file);
+#endif
+        length += std::max(read, 0);
+    } while (read == VGM_PLAYER_READ_SIZE);
+
+#ifdef MEGANOSTALGIA_ZLIB
+    gzclose(file);
+#else
+    fclose(file);
+#endif
+
+    data.resize(length);
+
+    if (length < VGM_PLAYER_OLD_DATA_START || data[0] != 'V' || data[1] != 'g' || data[2] != 'm' || data[3] != ' ') {
+        throw IOException(Utils::implodeString({"'", fileName, "' is not a VGM file"}));
+    }
+
+    uint32_t version = readValue(0x08, 4);
+    uint32_t dataOffset = readValue(0x34, 4);
+    dataStart = version >= 0x150 && dataOffset != 0 ? 0x34 + dataOffset : VGM_PLAYER_OLD_DATA_START;
+    totalSamples = readValue(0x18, 4);
+
+    if (dataStart >= length) {
+        throw IOException(Utils::implodeString({"'", fileName, "' has no VGM data"}));
+    }
+
+    reset();
+}
+
+/**
+ * Back to the start of the data, the chips should be reset alongside
+ */
+void VGMPlayer::reset() {
+    position = dataStart;
+    samplesPlayed = 0;
+    masterClock = 0;
+    ended = false;
+    pcmData.clear();
+    pcmPosition = 0;
+}
+
+/**
+ * Plays commands until the given sample (at the VGM rate of 44.1KHz) has been reached or the data ends. The last wait
+ * may go past it.
+ *
+ * @return Whether there is any more to play
+ */
+bool VGMPlayer::run(YM2612 &ym2612, SN76489 &psg, uint64_t sample) {
+    ym2612.setAccessClock(&masterClock);
+    psg.setAccessClock(&masterClock);
+
+    while (!ended && samplesPlayed < sample) {
+        if (position >= data.size()) {
+            ended = true;
+            break;
+        }
+
+        unsigned char command = data[position];
+        int length = getCommandLength(command);
+
+        if (position + length > data.size()) {
+            ended = true;
+            break;
+        }
+
+        switch (command) {
+            case 0x50:
+                psg.write(data[position + 1]);
+                break;
+            case 0x52:
+            case 0x53:
+                ym2612.write((command & 1) << 1, data[position + 1]);
+                ym2612.write(((command & 1) << 1) | 1, data[position + 2]);
+                break;
+            case 0x61:
+                wait(readValue(position + 1, 2));
+                break;
+            case 0x62:
+                wait(VGM_NTSC_FRAME_SAMPLES);
+                break;
+            case 0x63:
+                wait(VGM_PAL_FRAME_SAMPLES);
+                break;
+            case 0x66:
+                ended = true;
+                break;
+            case 0x67: {
+                // 0x67 0x66 type, 32 bit size, data. Type 0 is YM2612 PCM, the rest are for other chips.
+                uint32_t size = readValue(position + 3, 4);
+
+                if (data[position + 2] == 0x00 && position + length + size <= data.size()) {
+                    pcmData.insert(pcmData.end(), data.begin() + (long)(position + length),
+                                   data.begin() + (long)(position + length + size));
+                }
+
+                position += size;
+                break;
+            }
+            case 0xE0:
+                pcmPosition = readValue(position + 1, 4);
+                break;
+            default:
+                if (command >= 0x70 && command <= 0x7F) {
+                    wait((command & 0x0F) + 1);
+                } else if (command >= 0x80 && command <= 0x8F) {
+                    // Next byte of PCM data to the DAC, then wait 0-15 samples
+                    ym2612.write(0, 0x2A);
+                    ym2612.write(1, pcmPosition < pcmData.size() ? pcmData[pcmPosition] : 0x80);
+                    pcmPosition++;
+                    wait(command & 0x0F);
+                }
+                break;
+        }
+
+        position += length;
+    }
+
+    return !ended;
+}
+
+uint64_t VGMPlayer::getMasterClock() {
+    return masterClock;
+}
+
+/**
+ * Length of the file from its header, in samples at 44.1KHz
+ */
+uint64_t VGMPlayer::getTotalSamples() {
+    return totalSamples;
+}
+
+/**
+ * Rounded up, so recording what is played gives back the same waits
+ */
+void VGMPlayer::wait(uint64_t samples) {
+    samplesPlayed += samples;
+    masterClock = (samplesPlayed * MASTER_CLOCK_RATE + VGM_SAMPLE_RATE - 1) / VGM_SAMPLE_RATE;
+}
+
+uint32_t VGMPlayer::readValue(size_t offset, int bytes) {
+    uint32_t value = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint32_t)data[offset + i] << (i * 8);
+    }
+
+    return value;
+}
+
+/**
+ * Including the command byte, not counting the data after a data block's header. Commands for other chips are only
+ * needed for their length.
+ */
+int VGMPlayer::getCommandLength(unsigned char command) {
+    switch (command) {
+        case 0x4F:
+        case 0x50:
+            return 2;
+        case 0x61:
+            return 3;
+        case 0x62:
+        case 0x63:
+        case 0x66:
+            return 1;
+        case 0x67:
+            return 7;
+        case 0x90:
+        case 0x91:
+        case 0x95:
+            return 5;
+        case 0x92:
+            return 6;
+        case 0x93:
+            return 11;
+        case 0x94:
+            return 2;
+        default:
+            break;
+    }
+
+    if (command >= 0x30 && command <= 0x3F) {
+        return 2;
+    }
+
+    if ((command >= 0x40 && command <= 0x5F) || (command >= 0xA0 && command <= 0xBF)) {
+        return 3;
+    }
+
+    if (command >= 0xC0 && command <= 0xDF) {
+        return 4;
+    }
+
+    if (command >= 0xE0) {
+        return 5;
+    }
+
+    // 0x70-0x8F are single bytes, anything else unknown is treated as one too
+    return 1;
+}
@@ -0,0 +1,52 @@
+#ifndef MEGANOSTALGIA_VGMPLAYER_H
+#define MEGANOSTALGIA_VGMPLAYER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "YM2612.h"
+#include "SN76489.h"
+
+/**
+ * Plays the YM2612 and PSG writes from a VGM (or, built with zlib, VGZ) file straight into the sound chips, with no
+ * CPUs involved. The chips' access clock is moved along by the waits, so writes land at the right times.
+ *
+ * Commands for other chips are skipped. YM2612 PCM data blocks and the 0x8n DAC-write-and-wait commands are handled,
+ * the DAC stream control commands are not. The file is played once, ignoring the loop point.
+ */
+class VGMPlayer {
+public:
+
+    explicit VGMPlayer(const std::string &fileName);
+
+    void reset();
+
+    bool run(YM2612 &ym2612, SN76489 &psg, uint64_t sample);
+
+    uint64_t getMasterClock();
+
+    uint64_t getTotalSamples();
+
+private:
+
+    std::vector<unsigned char> data;
+    size_t dataStart;
+    uint64_t totalSamples;
+
+    size_t position;
+    uint64_t samplesPlayed;
+    uint64_t masterClock;
+    bool ended;
+
+    // YM2612 PCM data from the data blocks, read through by the 0x8n commands
+    std::vector<unsigned char> pcmData;
+    size_t pcmPosition;
+
+    void wait(uint64_t samples);
+
+    uint32_t readValue(size_t offset, int bytes);
+
+    static int getCommandLength(unsigned char command);
+};
+
+#endif //MEGANOSTALGIA_VGMPLAYER_H
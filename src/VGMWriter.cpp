@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cstring>
+#include "VGMWriter.h"
+#include "Exceptions.h"
+#include "Scheduler.h"
+
+#ifdef MEGANOSTALGIA_ZLIB
+#include <zlib.h>
+#endif
+
+// The chip clocks written to the header, the PSG runs off the Z80 clock and the YM2612 off the 68k clock
+#define VGM_SN76489_CLOCK (MASTER_CLOCK_RATE / Z80_CLOCK_DIVIDER)
+#define VGM_YM2612_CLOCK (MASTER_CLOCK_RATE / M68K_CLOCK_DIVIDER)
+
+/**
+ * @param startClock - Master clock time the file starts at, the chips should have just been reset
+ */
+VGMWriter::VGMWriter(const std::string &fileName, uint64_t startClock) {
+    file = nullptr;
+    compressedFile = nullptr;
+    bool compressed = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".vgz") == 0;
+
+    if (compressed) {
+#ifdef MEGANOSTALGIA_ZLIB
+        compressedFile = gzopen(fileName.c_str(), "wb");
+#else
+        throw IOException(Utils::implodeString({"Unable to write '", fileName, "', built without zlib so .vgz files can't be written"}));
+#endif
+    } else {
+        file = fopen(fileName.c_str(), "wb");
+    }
+
+    if (file == nullptr && compressedFile == nullptr) {
+        throw IOException(Utils::implodeString({"Unable to open VGM file '", fileName, "' for writing"}));
+    }
+
+    this->startClock = startClock;
+    samplesWritten = 0;
+    ym2612Address = 0;
+    pending.reserve(VGM_WRITER_PENDING_SIZE);
+    bufferLength = 0;
+    bytesWritten = 0;
+    commandsWritten = 0;
+
+    // Goes out with the first flush, then the lengths are filled in later if the file can be rewritten
+    writeHeader(buffer);
+    bufferLength = VGM_HEADER_SIZE;
+}
+
+/**
+ * Ends the file straight after the last write if it wasn't closed
+ */
+VGMWriter::~VGMWriter() {
+    if (file != nullptr || compressedFile != nullptr) {
+        close(startClock);
+    }
+}
+
+/**
+ * The address is taken from the last address write as the data is written, each CPU writes the pair together.
+ *
+ * @param port - 0 and 2 set the register address for part I and II, 1 and 3 write to it
+ */
+void VGMWriter::writeYM2612(uint64_t masterClock, int port, unsigned char value) {
+    if (!(port & 1)) {
+        ym2612Address = value;
+        return;
+    }
+
+    pending.push_back({masterClock, (unsigned char)((port & 2) ? 0x53 : 0x52), ym2612Address, value});
+}
+
+void VGMWriter::writePSG(uint64_t masterClock, unsigned char value) {
+    pending.push_back({masterClock, 0x50, value, 0});
+}
+
+/**
+ * Writes out every held write from before the given time, which must be somewhere no CPU can still write before
+ */
+void VGMWriter::commit(uint64_t masterClock) {
+    auto earlier = [](const VGMWrite &a, const VGMWrite &b) {
+        return a.time < b.time;
+    };
+
+    if (!std::is_sorted(pending.begin(), pending.end(), earlier)) {
+        std::stable_sort(pending.begin(), pending.end(), earlier);
+    }
+
+    size_t committed = 0;
+
+    while (committed < pending.size() && pending[committed].time < masterClock) {
+        const VGMWrite &write = pending[committed];
+        waitUntil(write.time);
+        writeCommand(write.command, write.command == 0x50 ? 1 : 2, write.first, write.second);
+        committed++;
+    }
+
+    pending.erase(pending.begin(), pending.begin() + (long)committed);
+}
+
+/**
+ * Writes out everything held, waits until the given time, ends the data and closes the file. Nothing more can be
+ * written after this.
+ */
+void VGMWriter::close(uint64_t masterClock) {
+    commit(UINT64_MAX);
+    waitUntil(masterClock);
+    writeCommand(0x66, 0);
+    flush();
+
+#ifdef MEGANOSTALGIA_ZLIB
+    if (compressedFile != nullptr) {
+        gzclose((gzFile)compressedFile);
+        compressedFile = nullptr;
+    }
+#endif
+
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+/**
+ * Commands written, not counting waits
+ */
+uint64_t VGMWriter::getCommandsWritten() {
+    return commandsWritten;
+}
+
+/**
+ * Writes the shortest run of wait commands that covers the time since the last command. Anything from before the start
+ * of the file goes out with no wait.
+ */
+void VGMWriter::waitUntil(uint64_t masterClock) {
+    if (masterClock <= startClock) {
+        return;
+    }
+
+    uint64_t sample = (masterClock - startClock) * VGM_SAMPLE_RATE / MASTER_CLOCK_RATE;
+
+    while (sample > samplesWritten) {
+        uint64_t samples = sample - samplesWritten;
+
+        if (samples == VGM_NTSC_FRAME_SAMPLES) {
+            writeCommand(0x62, 0);
+        } else if (samples == VGM_PAL_FRAME_SAMPLES) {
+            writeCommand(0x63, 0);
+        } else if (samples <= 16) {
+            writeCommand(0x70 | (samples - 1), 0);
+        } else {
+            samples = std::min(samples, (uint64_t)0xFFFF);
+            writeCommand(0x61, 2, samples & 0xFF, samples >> 8);
+        }
+
+        samplesWritten += samples;
+    }
+}
+
+void VGMWriter::writeCommand(unsigned char command, int length, unsigned char first, unsigned char second) {
+    if (bufferLength + VGM_WRITER_MAX_COMMAND_SIZE > VGM_WRITER_BUFFER_SIZE) {
+        flush();
+    }
+
+    buffer[bufferLength] = command;
+    buffer[bufferLength + 1] = first;
+    buffer[bufferLength + 2] = second;
+    bufferLength += 1 + length;
+
+    if (command < 0x61 || command > 0x7F) {
+        commandsWritten++;
+    }
+}
+
+void VGMWriter::flush() {
+    if (bufferLength == 0) {
+        return;
+    }
+
+#ifdef MEGANOSTALGIA_ZLIB
+    if (compressedFile != nullptr) {
+        gzwrite((gzFile)compressedFile, buffer, (unsigned int)bufferLength);
+    }
+#endif
+
+    if (file != nullptr) {
+        fwrite(buffer, 1, bufferLength, file);
+    }
+
+    bytesWritten += bufferLength;
+    bufferLength = 0;
+
+    // Keep the lengths in the header up to date, so the file is usable even if it is never closed
+    if (file != nullptr) {
+        unsigned char header[VGM_HEADER_SIZE];
+        writeHeader(header);
+        fseek(file, 0, SEEK_SET);
+        fwrite(header, 1, VGM_HEADER_SIZE, file);
+        fseek(file, 0, SEEK_END);
+    }
+}
+
+/**
+ * Version 1.50 header, with a 16 bit LFSR tapping bits 0 and 3 for the PSG
+ */
+void VGMWriter::writeHeader(unsigned char *header) {
+    memset(header, 0, VGM_HEADER_SIZE);
+
+    auto put = [header](int offset, uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            header[offset + i] = (value >> (i * 8)) & 0xFF;
+        }
+    };
+
+    // The file starts with the header, so its length is how many bytes have been written so far
+    bool known = bytesWritten > 0;
+    memcpy(header, "Vgm ", 4);
+    put(0x04, known ? (uint32_t)(bytesWritten - 4) : 0, 4);
+    put(0x08, 0x150, 4);
+    put(0x0C, VGM_SN76489_CLOCK, 4);
+    put(0x18, known ? (uint32_t)samplesWritten : 0, 4);
+    put(0x24, 60, 4);
+    put(0x28, 0x0009, 2);
+    put(0x2A, 16, 1);
+    put(0x2C, VGM_YM2612_CLOCK, 4);
+    put(0x34, VGM_HEADER_SIZE - 0x34, 4);
+}
@@ -0,0 +1,93 @@
+#ifndef MEGANOSTALGIA_VGMWRITER_H
+#define MEGANOSTALGIA_VGMWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// VGM files count time in samples at this rate, whatever the chips actually run at
+#define VGM_SAMPLE_RATE 44100
+
+// Waits that have a single byte command of their own, a 60Hz and a 50Hz frame
+#define VGM_NTSC_FRAME_SAMPLES 735
+#define VGM_PAL_FRAME_SAMPLES 882
+
+// Version 1.50 header, the data starts straight after it
+#define VGM_HEADER_SIZE 0x40
+
+// Commands are gathered up and written out this many bytes at a time
+#define VGM_WRITER_BUFFER_SIZE 65536
+
+// The longest command is a YM2612 write or a wait, 3 bytes
+#define VGM_WRITER_MAX_COMMAND_SIZE 3
+
+// Room for this many writes waiting to be put in order is set aside up front
+#define VGM_WRITER_PENDING_SIZE 4096
+
+/**
+ * A chip write waiting to go into the file, with the VGM command and its data bytes
+ */
+struct VGMWrite {
+    uint64_t time;
+    unsigned char command;
+    unsigned char first;
+    unsigned char second;
+};
+
+/**
+ * Records YM2612 and PSG writes into a VGM file as they happen, with the waits between them worked out from the master
+ * clock. Writes are appended to a fixed buffer which is written out when full, so nothing is allocated per write.
+ *
+ * The 68k runs through a whole slice before the Z80 does, so writes don't arrive in time order. They are held until
+ * commit() is told nothing earlier can still arrive, then sorted and written out.
+ *
+ * File names ending in .vgz are gzip compressed when built with zlib. The header of an uncompressed file is kept up to
+ * date with the length after every flush. A gzip stream can't be rewritten, so a compressed file's length fields are
+ * left at 0 and players go by the end command instead.
+ */
+class VGMWriter {
+public:
+
+    VGMWriter(const std::string &fileName, uint64_t startClock);
+
+    ~VGMWriter();
+
+    void writeYM2612(uint64_t masterClock, int port, unsigned char value);
+
+    void writePSG(uint64_t masterClock, unsigned char value);
+
+    void commit(uint64_t masterClock);
+
+    void close(uint64_t masterClock);
+
+    uint64_t getCommandsWritten();
+
+private:
+
+    FILE *file;
+    void *compressedFile;
+
+    uint64_t startClock;
+    uint64_t samplesWritten;
+
+    // Last address written to either YM2612 address port, VGM commands carry the address with each data write
+    unsigned char ym2612Address;
+
+    std::vector<VGMWrite> pending;
+
+    unsigned char buffer[VGM_WRITER_BUFFER_SIZE];
+    size_t bufferLength;
+    uint64_t bytesWritten;
+    uint64_t commandsWritten;
+
+    void waitUntil(uint64_t masterClock);
+
+    void writeCommand(unsigned char command, int length, unsigned char first = 0, unsigned char second = 0);
+
+    void flush();
+
+    void writeHeader(unsigned char *header);
+};
+
+#endif //MEGANOSTALGIA_VGMWRITER_H
@@ -0,0 +1,715 @@
+#include <algorithm>
+#include <cstring>
+#include "YM2612.h"
+#include "YM2612Tables.h"
+
+// Register offset of each operator in S1-S4 order (the registers go S1, S3, S2, S4)
+static const int operatorRegisterOffsets[4] = {0, 8, 4, 12};
+
+// Right shift of the LFO amplitude (0-126) for each AMS setting, 0dB/1.4dB/5.9dB/11.8dB
+static const int amShifts[4] = {8, 3, 1, 0};
+
+YM2612::YM2612() {
+    accessClock = nullptr;
+    vgmWriter = nullptr;
+#ifdef __SSE2__
+    vectorised = true;
+#else
+    vectorised = false;
+#endif
+    timingOnly = false;
+    reset();
+}
+
+void YM2612::reset() {
+    memset(registers, 0, sizeof(registers));
+    address = 0;
+    frequencyLatch = 0;
+    channel3FrequencyLatch = 0;
+    memset(channelFrequency, 0, sizeof(channelFrequency));
+    memset(channel3Frequency, 0, sizeof(channel3Frequency));
+
+    memset(phase, 0, sizeof(phase));
+    memset(keyCode, 0, sizeof(keyCode));
+    memset(feedbackHistory, 0, sizeof(feedbackHistory));
+
+    for (int op = 0; op < YM2612_OPERATORS; op++) {
+        envelopeAttenuation[op] = YM2612_MAX_ATTENUATION;
+        envelopeState[op] = YM2612EnvelopeState::Release;
+        keyOn[op] = false;
+    }
+
+    // Both speakers on, otherwise nothing is heard until a game sets the panning
+    for (int channel = 0; channel < YM2612_CHANNELS; channel++) {
+        registers[channel / 3][0xB4 + channel % 3] = 0xC0;
+    }
+
+    envelopeCounter = 0;
+    envelopeDivider = 0;
+    lfoCounter = 0;
+    lfoStep = 0;
+    timerACounter = 0;
+    timerBCounter = 0;
+    timerBPrescaler = 0;
+    status = 0;
+    timerAddress = 0;
+    memset(timerRegisters, 0, sizeof(timerRegisters));
+    timerSampleTime = YM2612_MASTER_CYCLES_PER_SAMPLE;
+    busyEndTime = 0;
+
+    nextSampleTime = YM2612_MASTER_CYCLES_PER_SAMPLE;
+    writeLog.clear();
+    dacLog.clear();
+    applyDAC(0);
+    output.clear();
+    samplesGenerated = 0;
+
+    for (int op = 0; op < YM2612_OPERATORS; op++) {
+        updateOperator(op);
+    }
+
+    updateLFO();
+}
+
+/**
+ * @param masterClock - Master clock of whichever CPU is about to run, writes are logged at its time
+ */
+void YM2612::setAccessClock(const uint64_t *masterClock) {
+    accessClock = masterClock;
+}
+
+/**
+ * @param writer - Every write is recorded to it from now on, nullptr to stop
+ */
+void YM2612::setVGMWriter(VGMWriter *writer) {
+    vgmWriter = writer;
+}
+
+/**
+ * Generates every sample due by the given master clock time into the output buffer, applying the logged writes in
+ * between. A write lands before the first sample after it, so the samples between two writes are generated in one go.
+ * The register and DAC logs are each sorted by time, then merged as they are applied.
+ */
+void YM2612::catchUp(uint64_t masterClock) {
+    size_t applied = 0;
+    size_t dacApplied = 0;
+
+    if (timingOnly) {
+        if (masterClock >= nextSampleTime) {
+            nextSampleTime += ((masterClock - nextSampleTime) / YM2612_MASTER_CYCLES_PER_SAMPLE + 1) * YM2612_MASTER_CYCLES_PER_SAMPLE;
+        }
+
+        return;
+    }
+
+    sortSoundWrites(writeLog);
+    sortSoundWrites(dacLog);
+
+    if (masterClock >= nextSampleTime) {
+        size_t start = output.size();
+        output.resize(start + ((masterClock - nextSampleTime) / YM2612_MASTER_CYCLES_PER_SAMPLE + 1) * 2);
+        int16_t *buffer = &output[start];
+
+        while (nextSampleTime <= masterClock) {
+            while (applied < writeLog.size() && writeLog[applied].time < nextSampleTime) {
+                applyWrite(writeLog[applied].port, writeLog[applied].value);
+                applied++;
+            }
+
+            while (dacApplied < dacLog.size() && dacLog[dacApplied].time < nextSampleTime) {
+                applyDAC(dacLog[dacApplied].value);
+                dacApplied++;
+            }
+
+            uint64_t end = masterClock;
+
+            if (applied < writeLog.size()) {
+                end = std::min(end, writeLog[applied].time);
+            }
+
+            if (dacApplied < dacLog.size()) {
+                end = std::min(end, dacLog[dacApplied].time);
+            }
+
+            int count = (int)((end - nextSampleTime) / YM2612_MASTER_CYCLES_PER_SAMPLE) + 1;
+            generateSamples(buffer, count);
+            buffer += count * 2;
+            nextSampleTime += (uint64_t)count * YM2612_MASTER_CYCLES_PER_SAMPLE;
+        }
+    }
+
+    while (applied < writeLog.size() && writeLog[applied].time <= masterClock) {
+        applyWrite(writeLog[applied].port, writeLog[applied].value);
+        applied++;
+    }
+
+    while (dacApplied < dacLog.size() && dacLog[dacApplied].time <= masterClock) {
+        applyDAC(dacLog[dacApplied].value);
+        dacApplied++;
+    }
+
+    writeLog.erase(writeLog.begin(), writeLog.begin() + applied);
+    dacLog.erase(dacLog.begin(), dacLog.begin() + dacApplied);
+}
+
+void YM2612::catchUpToAccess() {
+    if (accessClock != nullptr) {
+        catchUp(*accessClock);
+    }
+}
+
+/**
+ * Bit 7 - busy, bit 1 - timer B overflow, bit 0 - timer A overflow. All four ports return the status.
+ *
+ * Only the timers are brought up to date, the logged writes can't affect them.
+ */
+unsigned char YM2612::readStatus() {
+    if (accessClock == nullptr) {
+        return status;
+    }
+
+    runTimers(*accessClock);
+    return *accessClock < busyEndTime ? status | 0x80 : status;
+}
+
+/**
+ * Writes are logged and only applied when the chip next catches up, except for the timers which are handled straight
+ * away. Without an access clock there is no time to log them at, so they are applied immediately, as they are in
+ * timing only mode where nothing needs to happen at the right time.
+ *
+ * @param port - 0 and 2 set the register address for part I and II, 1 and 3 write to it
+ */
+void YM2612::write(int port, unsigned char value) {
+    if (vgmWriter != nullptr) {
+        vgmWriter->writeYM2612(accessClock != nullptr ? *accessClock : 0, port, value);
+    }
+
+    if (accessClock != nullptr && (port & 1)) {
+        busyEndTime = *accessClock + YM2612_BUSY_MASTER_CYCLES;
+    }
+
+    // DAC samples, the address is usually left at 0x2A while a driver streams them
+    if ((port & 3) == 1 && timerAddress == 0x2A) {
+        if (accessClock == nullptr || timingOnly) {
+            applyDAC(value);
+        } else {
+            dacLog.push_back({*accessClock, (unsigned char)port, value});
+        }
+
+        return;
+    }
+
+    writeTimers(port, value);
+
+    if (accessClock == nullptr || timingOnly) {
+        applyWrite(port, value);
+        return;
+    }
+
+    writeLog.push_back({*accessClock, (unsigned char)port, value});
+
+    if (writeLog.size() >= SOUND_WRITE_LOG_SIZE) {
+        catchUp(*accessClock);
+    }
+}
+
+/**
+ * 8 bit unsigned, scaled up to the same range as the channels
+ */
+void YM2612::applyDAC(unsigned char value) {
+    registers[0][0x2A] = value;
+    dacOutput = (value - 0x80) << 6;
+}
+
+void YM2612::applyWrite(int port, unsigned char value) {
+    switch (port & 3) {
+        case 0:
+            address = value;
+            break;
+        case 2:
+            address = 0x100 | value;
+            break;
+        default:
+            // Part I data writes use the part I address, part II data writes the part II address
+            writeRegister((port >> 1) & 1, address & 0xFF, value);
+            break;
+    }
+}
+
+/**
+ * Follows part I writes to the timer registers (0x24-0x27) as they happen, using the address as it is at the time of
+ * the write rather than once the log has been applied
+ */
+void YM2612::writeTimers(int port, unsigned char value) {
+    switch (port & 3) {
+        case 0:
+        case 2:
+            timerAddress = value;
+            break;
+        case 1:
+            if (timerAddress >= 0x24 && timerAddress <= 0x27) {
+                if (accessClock != nullptr) {
+                    runTimers(*accessClock);
+                }
+
+                unsigned char previous = timerRegisters[timerAddress - 0x24];
+                timerRegisters[timerAddress - 0x24] = value;
+
+                if (timerAddress == 0x27) {
+                    writeTimerControl(previous, value);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Stereo samples (left then right) straight from the chip, at its own sample rate
+ */
+void YM2612::generateSamples(int16_t *buffer, int count) {
+    for (int i = 0; i < count; i++) {
+        runSample(buffer[i * 2], buffer[i * 2 + 1]);
+    }
+
+    samplesGenerated += count;
+}
+
+/**
+ * Turning vectorisation off uses the scalar reference path, used to check the two give identical output
+ */
+void YM2612::setVectorised(bool enabled) {
+#ifdef __SSE2__
+    vectorised = enabled;
+#endif
+}
+
+/**
+ * Switches to (or back from) only keeping the timers and busy flag running. Anything still in the log is applied
+ * without being synthesised, and the envelopes and LFO carry on from where they were left when switching back.
+ */
+void YM2612::setTimingOnly(bool enabled) {
+    if (enabled == timingOnly) {
+        return;
+    }
+
+    for (const SoundWrite &write : writeLog) {
+        applyWrite(write.port, write.value);
+    }
+
+    if (!dacLog.empty()) {
+        applyDAC(dacLog.back().value);
+    }
+
+    writeLog.clear();
+    dacLog.clear();
+    timingOnly = enabled;
+}
+
+bool YM2612::isTimingOnly() {
+    return timingOnly;
+}
+
+const std::vector<int16_t> &YM2612::getOutput() {
+    return output;
+}
+
+void YM2612::clearOutput() {
+    output.clear();
+}
+
+uint64_t YM2612::getSamplesGenerated() {
+    return samplesGenerated;
+}
+
+void YM2612::writeRegister(int part, int reg, unsigned char value) {
+    if (part == 0 && reg < 0x30) {
+        registers[0][reg] = value;
+
+        switch (reg) {
+            case 0x22:
+                // LFO enable (bit 3) and frequency
+                if (!(value & 0x08)) {
+                    lfoCounter = 0;
+                    lfoStep = 0;
+                    updateLFO();
+                }
+                break;
+            case 0x27:
+                // The timer bits were handled when the write was logged, only the channel 3 mode matters here
+                updateFrequency(2);
+                break;
+            case 0x2A:
+                applyDAC(value);
+                break;
+            case 0x28:
+                writeKeyOnOff(value);
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    if (reg < 0x30 || (reg & 3) == 3) {
+        return;
+    }
+
+    registers[part][reg] = value;
+
+    if (reg < 0xA0) {
+        writeOperatorRegister(part, reg);
+        return;
+    }
+
+    writeChannelRegister(part, reg, value);
+}
+
+void YM2612::writeOperatorRegister(int part, int reg) {
+    int channel = part * 3 + (reg & 3);
+
+    // Register order is S1, S3, S2, S4
+    static const int registerSlots[4] = {0, 2, 1, 3};
+    int op = channel * 4 + registerSlots[(reg >> 2) & 3];
+
+    updateOperator(op);
+}
+
+void YM2612::writeChannelRegister(int part, int reg, unsigned char value) {
+    int channel = part * 3 + (reg & 3);
+
+    switch (reg & 0xFC) {
+        case 0xA0:
+            channelFrequency[channel] = ((frequencyLatch & 0x3F) << 8) | value;
+            updateFrequency(channel);
+            break;
+        case 0xA4:
+            frequencyLatch = value;
+            break;
+        case 0xA8:
+            if (part == 0) {
+                // Channel 3 special mode frequencies, 0xA9 is S1, 0xAA is S2 and 0xA8 is S3
+                static const int channel3Slots[3] = {2, 0, 1};
+                channel3Frequency[channel3Slots[reg & 3]] = ((channel3FrequencyLatch & 0x3F) << 8) | value;
+                updateFrequency(2);
+            }
+            break;
+        case 0xAC:
+            if (part == 0) {
+                channel3FrequencyLatch = value;
+            }
+            break;
+        case 0xB4:
+            // AMS and PMS
+            for (int op = channel * 4; op < channel * 4 + 4; op++) {
+                updateOperator(op);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Bits 0-1 load timers A and B (they run while set), 2-3 let them set the overflow flags, 4-5 clear the flags. Bits
+ * 6-7 (channel 3 mode) are handled when the write is applied.
+ */
+void YM2612::writeTimerControl(unsigned char previous, unsigned char value) {
+    if ((value & 0x01) && !(previous & 0x01)) {
+        timerACounter = (timerRegisters[0] << 2) | (timerRegisters[1] & 0x03);
+    }
+
+    if ((value & 0x02) && !(previous & 0x02)) {
+        timerBCounter = timerRegisters[2];
+        timerBPrescaler = 0;
+    }
+
+    if (value & 0x10) {
+        status &= ~0x01;
+    }
+
+    if (value & 0x20) {
+        status &= ~0x02;
+    }
+}
+
+/**
+ * Brings the timers up to the given master clock time. Timer A counts up once a sample from its 10 bit value, timer B
+ * once every 16 samples from its 8 bit value, and each reloads when it passes the top. The overflows are worked out
+ * rather than counted out a sample at a time.
+ */
+void YM2612::runTimers(uint64_t masterClock) {
+    if (masterClock < timerSampleTime) {
+        return;
+    }
+
+    uint64_t samples = (masterClock - timerSampleTime) / YM2612_MASTER_CYCLES_PER_SAMPLE + 1;
+    timerSampleTime += samples * YM2612_MASTER_CYCLES_PER_SAMPLE;
+    unsigned char control = timerRegisters[3];
+
+    if (control & 0x01) {
+        timerACounter = runTimer(timerACounter, samples, (timerRegisters[0] << 2) | (timerRegisters[1] & 0x03), 1024,
+                                 (control >> 2) & 0x01);
+    }
+
+    if (control & 0x02) {
+        uint64_t prescaled = timerBPrescaler + samples;
+        timerBPrescaler = (int)(prescaled % 16);
+        timerBCounter = runTimer(timerBCounter, prescaled / 16, timerRegisters[2], 256, (control >> 2) & 0x02);
+    }
+}
+
+/**
+ * @param flag - Status bit to set if the timer overflows
+ * @return The new counter value
+ */
+int YM2612::runTimer(int counter, uint64_t ticks, int reload, int top, unsigned char flag) {
+    uint64_t remaining = top - counter;
+
+    if (ticks < remaining) {
+        return counter + (int)ticks;
+    }
+
+    status |= flag;
+    return reload + (int)((ticks - remaining) % (top - reload));
+}
+
+/**
+ * Bits 0-2 select the channel (0-2 part I, 4-6 part II), bits 4-7 key on S1-S4
+ */
+void YM2612::writeKeyOnOff(unsigned char value) {
+    int channel = value & 0x03;
+
+    if (channel == 3) {
+        return;
+    }
+
+    if (value & 0x04) {
+        channel += 3;
+    }
+
+    for (int slot = 0; slot < 4; slot++) {
+        int op = channel * 4 + slot;
+        bool on = (value >> (4 + slot)) & 1;
+
+        if (on && !keyOn[op]) {
+            phase[op] = 0;
+            setEnvelopeState(op, YM2612EnvelopeState::Attack);
+        } else if (!on && keyOn[op]) {
+            setEnvelopeState(op, YM2612EnvelopeState::Release);
+        }
+
+        keyOn[op] = on;
+    }
+}
+
+unsigned char YM2612::getOperatorRegister(int op, int reg) {
+    int channel = op >> 2;
+    return registers[channel / 3][reg + channel % 3 + operatorRegisterOffsets[op & 3]];
+}
+
+/**
+ * Works out everything about an operator that comes from its registers
+ */
+void YM2612::updateOperator(int op) {
+    int channel = op >> 2;
+    unsigned char sustain = getOperatorRegister(op, 0x80) >> 4;
+
+    totalLevel[op] = (getOperatorRegister(op, 0x40) & 0x7F) << 3;
+    sustainLevel[op] = sustain == 15 ? 0x3E0 : sustain << 5;
+
+    amAttenuation[op] = getAMAttenuation(op);
+
+    updateFrequency(channel);
+    updateEnvelopeRate(op);
+}
+
+/**
+ * Phase increments and key codes for a channel, including any vibrato
+ */
+void YM2612::updateFrequency(int channel) {
+    bool special = channel == 2 && (registers[0][0x27] & 0xC0);
+    int pms = registers[channel / 3][0xB4 + channel % 3] & 0x07;
+
+    // Vibrato follows the top 5 bits of the LFO step. The key code comes from the F-number before vibrato.
+    int pmStep = lfoStep >> 2;
+
+    for (int slot = 0; slot < 4; slot++) {
+        int op = channel * 4 + slot;
+        uint16_t frequency = (special && slot < 3) ? channel3Frequency[slot] : channelFrequency[channel];
+        int code = getKeyCode(frequency);
+        int pmAdjustment = pms != 0 ? ym2612PMAdjustment(frequency, pms, pmStep) : 0;
+
+        unsigned char detuneMultiple = getOperatorRegister(op, 0x30);
+        phaseIncrement[op] = getPhaseIncrement(frequency, pmAdjustment, code, (detuneMultiple >> 4) & 0x07,
+                                               detuneMultiple & 0x0F);
+
+        if (keyCode[op] != code) {
+            keyCode[op] = code;
+            updateEnvelopeRate(op);
+        }
+    }
+}
+
+/**
+ * The rate for the operator's current envelope state, scaled up for higher notes by the key scale setting
+ */
+void YM2612::updateEnvelopeRate(int op) {
+    int rate;
+
+    switch (envelopeState[op]) {
+        case YM2612EnvelopeState::Attack:
+            rate = getOperatorRegister(op, 0x50) & 0x1F;
+            break;
+        case YM2612EnvelopeState::Decay:
+            rate = getOperatorRegister(op, 0x60) & 0x1F;
+            break;
+        case YM2612EnvelopeState::Sustain:
+            rate = getOperatorRegister(op, 0x70) & 0x1F;
+            break;
+        default:
+            rate = (getOperatorRegister(op, 0x80) & 0x0F) * 2 + 1;
+            break;
+    }
+
+    int keyScale = getOperatorRegister(op, 0x50) >> 6;
+    envelopeRate[op] = rate == 0 ? 0 : std::min(63, rate * 2 + (keyCode[op] >> (3 - keyScale)));
+    attackMask[op] = envelopeState[op] == YM2612EnvelopeState::Attack ? -1 : 0;
+}
+
+void YM2612::setEnvelopeState(int op, YM2612EnvelopeState state) {
+    envelopeState[op] = state;
+    updateEnvelopeRate(op);
+
+    // The fastest attack rates jump straight to full volume
+    if (state == YM2612EnvelopeState::Attack && envelopeRate[op] >= 62) {
+        envelopeAttenuation[op] = 0;
+        envelopeState[op] = YM2612EnvelopeState::Decay;
+        updateEnvelopeRate(op);
+    }
+}
+
+/**
+ * Tremolo and vibrato depend on the LFO step, so need updating whenever it changes
+ */
+void YM2612::updateLFO() {
+    for (int channel = 0; channel < YM2612_CHANNELS; channel++) {
+        for (int op = channel * 4; op < channel * 4 + 4; op++) {
+            amAttenuation[op] = getAMAttenuation(op);
+        }
+
+        if (registers[channel / 3][0xB4 + channel % 3] & 0x07) {
+            updateFrequency(channel);
+        }
+    }
+}
+
+/**
+ * Tremolo follows a triangle wave (0-126), scaled by the channel's AMS for operators with AM enabled
+ */
+int16_t YM2612::getAMAttenuation(int op) {
+    int channel = op >> 2;
+
+    if (!(getOperatorRegister(op, 0x60) & 0x80)) {
+        return 0;
+    }
+
+    int ams = (registers[channel / 3][0xB4 + channel % 3] >> 4) & 0x03;
+    int lfoAmplitude = lfoStep < 64 ? lfoStep * 2 : (127 - lfoStep) * 2;
+    return lfoAmplitude >> amShifts[ams];
+}
+
+/**
+ * Key code (block and the top F-number bits), used for detune and key scaling
+ */
+int YM2612::getKeyCode(uint16_t frequency) {
+    int block = (frequency >> 11) & 0x07;
+    bool f11 = frequency & 0x400;
+    bool f10 = frequency & 0x200;
+    bool f9 = frequency & 0x100;
+    bool f8 = frequency & 0x080;
+    return (block << 2) | (f11 << 1) | ((f11 && (f10 || f9 || f8)) || (!f11 && f10 && f9 && f8));
+}
+
+/**
+ * @param frequency - Block (bits 11-13) and F-number (bits 0-10)
+ * @param pmAdjustment - Vibrato, in half F-number steps. The adjusted F-number wraps rather than clamps, as the chip's
+ *                       does.
+ * @return Amount added to the 20 bit phase counter each sample
+ */
+uint32_t YM2612::getPhaseIncrement(uint16_t frequency, int pmAdjustment, int keyCode, int detune, int multiple) {
+    int block = (frequency >> 11) & 0x07;
+    int fnum = (((frequency & 0x7FF) << 1) + pmAdjustment) & 0xFFF;
+    int increment = (fnum << block) >> 2;
+    int detuneAmount = ym2612DetuneTable[keyCode][detune & 0x03];
+    increment = ((detune & 0x04) ? increment - detuneAmount : increment + detuneAmount) & 0x1FFFF;
+    return multiple == 0 ? increment >> 1 : increment * multiple;
+}
+
+void YM2612::getSaveStateData(YM2612SaveStateData &data) {
+    // Nothing in the log is saved, so apply it first
+    catchUpToAccess();
+
+    memcpy(data.registers, registers, sizeof(registers));
+    data.address = address;
+    data.frequencyLatch = frequencyLatch;
+    data.channel3FrequencyLatch = channel3FrequencyLatch;
+    memcpy(data.channelFrequency, channelFrequency, sizeof(channelFrequency));
+    memcpy(data.channel3Frequency, channel3Frequency, sizeof(channel3Frequency));
+    memcpy(data.phase, phase, sizeof(phase));
+    memcpy(data.envelopeAttenuation, envelopeAttenuation, sizeof(envelopeAttenuation));
+    memcpy(data.envelopeState, envelopeState, sizeof(envelopeState));
+    memcpy(data.keyOn, keyOn, sizeof(keyOn));
+    memcpy(data.feedbackHistory, feedbackHistory, sizeof(feedbackHistory));
+    data.envelopeCounter = envelopeCounter;
+    data.envelopeDivider = envelopeDivider;
+    data.lfoCounter = lfoCounter;
+    data.lfoStep = lfoStep;
+    data.timerACounter = timerACounter;
+    data.timerBCounter = timerBCounter;
+    data.timerBPrescaler = timerBPrescaler;
+    data.status = status;
+    data.timerSampleTime = timerSampleTime;
+    data.busyEndTime = busyEndTime;
+    data.nextSampleTime = nextSampleTime;
+}
+
+void YM2612::restoreState(const YM2612SaveStateData &data) {
+    memcpy(registers, data.registers, sizeof(registers));
+    address = data.address;
+    frequencyLatch = data.frequencyLatch;
+    channel3FrequencyLatch = data.channel3FrequencyLatch;
+    memcpy(channelFrequency, data.channelFrequency, sizeof(channelFrequency));
+    memcpy(channel3Frequency, data.channel3Frequency, sizeof(channel3Frequency));
+    memcpy(phase, data.phase, sizeof(phase));
+    memcpy(envelopeAttenuation, data.envelopeAttenuation, sizeof(envelopeAttenuation));
+    memcpy(envelopeState, data.envelopeState, sizeof(envelopeState));
+    memcpy(keyOn, data.keyOn, sizeof(keyOn));
+    memcpy(feedbackHistory, data.feedbackHistory, sizeof(feedbackHistory));
+    envelopeCounter = data.envelopeCounter;
+    envelopeDivider = data.envelopeDivider;
+    lfoCounter = data.lfoCounter;
+    lfoStep = data.lfoStep;
+    timerACounter = data.timerACounter;
+    timerBCounter = data.timerBCounter;
+    timerBPrescaler = data.timerBPrescaler;
+    status = data.status;
+    timerSampleTime = data.timerSampleTime;
+    busyEndTime = data.busyEndTime;
+    nextSampleTime = data.nextSampleTime;
+    output.clear();
+    writeLog.clear();
+    dacLog.clear();
+    applyDAC(registers[0][0x2A]);
+
+    // The log was empty when saved, so the timers' view of the registers is the same as the chip's
+    timerAddress = address & 0xFF;
+    memcpy(timerRegisters, &registers[0][0x24], sizeof(timerRegisters));
+
+    for (int op = 0; op < YM2612_OPERATORS; op++) {
+        updateOperator(op);
+    }
+
+    updateLFO();
+}
@@ -0,0 +1,240 @@
+#ifndef MEGANOSTALGIA_YM2612_H
+#define MEGANOSTALGIA_YM2612_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "SoundWriteLog.h"
+#include "VGMWriter.h"
+
+#define YM2612_CHANNELS 6
+#define YM2612_OPERATORS 24
+
+// The YM2612 is clocked at the master clock divided by 7 and takes 144 of its own clocks to produce a sample
+#define YM2612_MASTER_CYCLES_PER_SAMPLE (7 * 144)
+
+// The envelope generator only steps every third sample
+#define YM2612_ENVELOPE_SAMPLE_DIVIDER 3
+
+// Envelope attenuation is 10 bits, 0 is full volume
+#define YM2612_MAX_ATTENUATION 0x3FF
+
+// The busy flag is set for 32 of the chip's internal cycles (its clock divided by 6) after a data write
+#define YM2612_BUSY_MASTER_CYCLES (32 * 6 * 7)
+
+enum YM2612EnvelopeState {
+    Attack,
+    Decay,
+    Sustain,
+    Release
+};
+
+/**
+ * Only the registers and the running state are saved, everything else is worked out again from the registers
+ */
+struct YM2612SaveStateData {
+    unsigned char registers[2][256];
+    uint16_t address;
+    unsigned char frequencyLatch;
+    unsigned char channel3FrequencyLatch;
+    uint16_t channelFrequency[YM2612_CHANNELS];
+    uint16_t channel3Frequency[3];
+    uint32_t phase[YM2612_OPERATORS];
+    int16_t envelopeAttenuation[YM2612_OPERATORS];
+    unsigned char envelopeState[YM2612_OPERATORS];
+    bool keyOn[YM2612_OPERATORS];
+    int16_t feedbackHistory[YM2612_CHANNELS][2];
+    uint32_t envelopeCounter;
+    int envelopeDivider;
+    int lfoCounter;
+    int lfoStep;
+    int timerACounter;
+    int timerBCounter;
+    int timerBPrescaler;
+    unsigned char status;
+    uint64_t timerSampleTime;
+    uint64_t busyEndTime;
+    uint64_t nextSampleTime;
+};
+
+static_assert(std::is_trivially_copyable<YM2612SaveStateData>::value, "YM2612SaveStateData must be trivially copyable");
+
+/**
+ * The YM2612 FM synthesiser: 6 channels of 4 operators, with an envelope generator, LFO, timers and a DAC that can
+ * replace channel 6.
+ *
+ * Operator state is kept as structure-of-arrays indexed by channel * 4 + operator (operators in S1-S4 order, not
+ * register order), so the phase and envelope of all 24 operators are stepped together with SSE2 each sample. The
+ * waveform lookups and algorithms are then worked out per channel. The scalar path is the reference the vectorised one
+ * must match exactly.
+ *
+ * Writes are logged with the time in the access clock, and the chip is only run when it is caught up (at the end of
+ * a frame, or once the log fills up), generating everything between the writes in one go into an output buffer. The
+ * timers are the exception, they are cheap to work out so they are kept up to date as writes and status reads happen.
+ * DAC samples (data writes to 0x2A) have a log of their own, since drivers stream thousands of them a frame. They skip
+ * the register write handling and feed channel 6 directly.
+ *
+ * In timing only mode nothing is synthesised. Writes go straight to the registers, catching up just moves the sample
+ * time along, and only the timers and busy flag (all a game can read back) are modelled.
+ */
+class YM2612 {
+public:
+
+    YM2612();
+
+    void reset();
+
+    void setAccessClock(const uint64_t *masterClock);
+
+    void setVGMWriter(VGMWriter *writer);
+
+    void catchUp(uint64_t masterClock);
+
+    unsigned char readStatus();
+
+    void write(int port, unsigned char value);
+
+    void generateSamples(int16_t *output, int count);
+
+    void setVectorised(bool enabled);
+
+    void setTimingOnly(bool enabled);
+
+    bool isTimingOnly();
+
+    const std::vector<int16_t> &getOutput();
+
+    void clearOutput();
+
+    uint64_t getSamplesGenerated();
+
+    static const char *getImplementationName();
+
+    void getSaveStateData(YM2612SaveStateData &data);
+
+    void restoreState(const YM2612SaveStateData &data);
+
+private:
+
+    unsigned char registers[2][256];
+
+    // Address written to port 0 (part I) or port 2 (part II, bit 8 set)
+    uint16_t address;
+
+    // The high frequency registers (0xA4-0xA6, 0xAC-0xAE) are latched until the low byte is written
+    unsigned char frequencyLatch;
+    unsigned char channel3FrequencyLatch;
+
+    // Block (bits 11-13) and F-number (bits 0-10) of each channel, and of S1-S3 in channel 3 special mode
+    uint16_t channelFrequency[YM2612_CHANNELS];
+    uint16_t channel3Frequency[3];
+
+    // Operator state, [channel * 4 + operator]
+    alignas(16) uint32_t phase[YM2612_OPERATORS];
+    alignas(16) uint32_t phaseIncrement[YM2612_OPERATORS];
+    alignas(16) int16_t envelopeAttenuation[YM2612_OPERATORS];
+    alignas(16) int16_t envelopeIncrement[YM2612_OPERATORS];
+    alignas(16) int16_t attackMask[YM2612_OPERATORS];
+    alignas(16) int16_t totalLevel[YM2612_OPERATORS];
+    alignas(16) int16_t amAttenuation[YM2612_OPERATORS];
+    alignas(16) int16_t attenuation[YM2612_OPERATORS];
+    int16_t sustainLevel[YM2612_OPERATORS];
+    unsigned char envelopeState[YM2612_OPERATORS];
+    unsigned char envelopeRate[YM2612_OPERATORS];
+    unsigned char keyCode[YM2612_OPERATORS];
+    bool keyOn[YM2612_OPERATORS];
+
+    // The last two outputs of S1, which can feed back into itself
+    int16_t feedbackHistory[YM2612_CHANNELS][2];
+
+    uint32_t envelopeCounter;
+    int envelopeDivider;
+
+    int lfoCounter;
+    int lfoStep;
+
+    int timerACounter;
+    int timerBCounter;
+    int timerBPrescaler;
+    unsigned char status;
+
+    // The timers see writes as they happen, so they keep their own address and copy of registers 0x24-0x27. The
+    // address also picks out DAC writes as they are made.
+    unsigned char timerAddress;
+    unsigned char timerRegisters[4];
+    uint64_t timerSampleTime;
+
+    // Master clock time the busy flag clears
+    uint64_t busyEndTime;
+
+    bool vectorised;
+    bool timingOnly;
+
+    const uint64_t *accessClock;
+    VGMWriter *vgmWriter;
+    std::vector<SoundWrite> writeLog;
+
+    // Written to 0x2A since the last catch up, and what channel 6 plays when the DAC is enabled
+    std::vector<SoundWrite> dacLog;
+    int dacOutput;
+
+    uint64_t nextSampleTime;
+    std::vector<int16_t> output;
+    uint64_t samplesGenerated;
+
+    void catchUpToAccess();
+
+    void applyWrite(int port, unsigned char value);
+
+    void applyDAC(unsigned char value);
+
+    void writeTimers(int port, unsigned char value);
+
+    void writeRegister(int part, int reg, unsigned char value);
+
+    void writeOperatorRegister(int part, int reg);
+
+    void writeChannelRegister(int part, int reg, unsigned char value);
+
+    void writeTimerControl(unsigned char previous, unsigned char value);
+
+    void writeKeyOnOff(unsigned char value);
+
+    unsigned char getOperatorRegister(int op, int reg);
+
+    void updateOperator(int op);
+
+    void updateFrequency(int channel);
+
+    void updateEnvelopeRate(int op);
+
+    void updateLFO();
+
+    int16_t getAMAttenuation(int op);
+
+    void setEnvelopeState(int op, YM2612EnvelopeState state);
+
+    void runSample(int16_t &left, int16_t &right);
+
+    void runTimers(uint64_t masterClock);
+
+    int runTimer(int counter, uint64_t ticks, int reload, int top, unsigned char flag);
+
+    void stepEnvelopes();
+
+    void advanceOperators(bool envelopeStep);
+
+    void advanceOperatorsScalar(bool envelopeStep);
+
+    void advanceOperatorsSSE2(bool envelopeStep);
+
+    int getChannelOutput(int channel);
+
+    int getOperatorOutput(int op, int modulation);
+
+    static int getKeyCode(uint16_t frequency);
+
+    static uint32_t getPhaseIncrement(uint16_t frequency, int pmAdjustment, int keyCode, int detune, int multiple);
+};
+
+#endif //MEGANOSTALGIA_YM2612_H
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include "YM2612.h"
+#include "YM2612Tables.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Samples per LFO step for each LFO frequency setting, there are 128 steps per LFO cycle
+static const int lfoPeriods[8] = {108, 77, 71, 67, 62, 44, 8, 5};
+
+/**
+ * Runs the chip for one sample
+ */
+void YM2612::runSample(int16_t &left, int16_t &right) {
+    if (registers[0][0x22] & 0x08) {
+        if (++lfoCounter >= lfoPeriods[registers[0][0x22] & 0x07]) {
+            lfoCounter = 0;
+            lfoStep = (lfoStep + 1) & 0x7F;
+            updateLFO();
+        }
+    }
+
+    bool envelopeStep = false;
+
+    if (++envelopeDivider == YM2612_ENVELOPE_SAMPLE_DIVIDER) {
+        envelopeDivider = 0;
+        stepEnvelopes();
+        envelopeStep = true;
+    }
+
+    advanceOperators(envelopeStep);
+
+    int leftTotal = 0;
+    int rightTotal = 0;
+
+    for (int channel = 0; channel < YM2612_CHANNELS; channel++) {
+        int channelOutput;
+
+        if (channel == 5 && (registers[0][0x2B] & 0x80)) {
+            // The DAC replaces channel 6
+            channelOutput = dacOutput;
+        } else {
+            channelOutput = getChannelOutput(channel);
+        }
+
+        // Each channel goes through a 9 bit DAC
+        channelOutput = (channelOutput >> 5) << 4;
+        unsigned char panning = registers[channel / 3][0xB4 + channel % 3];
+
+        if (panning & 0x80) {
+            leftTotal += channelOutput;
+        }
+
+        if (panning & 0x40) {
+            rightTotal += channelOutput;
+        }
+    }
+
+    left = (int16_t)std::clamp(leftTotal, -32768, 32767);
+    right = (int16_t)std::clamp(rightTotal, -32768, 32767);
+}
+
+/**
+ * Works out how much each operator's envelope moves this envelope cycle and handles the state changes from the last
+ * one. The increments depend only on the rate, so they are looked up once per rate and then gathered per operator.
+ */
+void YM2612::stepEnvelopes() {
+    envelopeCounter++;
+
+    unsigned char rateIncrements[64];
+
+    for (int rate = 0; rate < 64; rate++) {
+        int shift = rate < 48 ? 11 - (rate >> 2) : 0;
+
+        if (envelopeCounter & ((1 << shift) - 1)) {
+            rateIncrements[rate] = 0;
+        } else {
+            rateIncrements[rate] = ym2612EnvelopeIncrementTable[rate][(envelopeCounter >> shift) & 7];
+        }
+    }
+
+    for (int op = 0; op < YM2612_OPERATORS; op++) {
+        switch (envelopeState[op]) {
+            case YM2612EnvelopeState::Attack:
+                if (envelopeAttenuation[op] == 0) {
+                    setEnvelopeState(op, YM2612EnvelopeState::Decay);
+                }
+                break;
+            case YM2612EnvelopeState::Decay:
+                if (envelopeAttenuation[op] >= sustainLevel[op]) {
+                    setEnvelopeState(op, YM2612EnvelopeState::Sustain);
+                }
+                break;
+            default:
+                break;
+        }
+
+        envelopeIncrement[op] = rateIncrements[envelopeRate[op]];
+    }
+}
+
+void YM2612::advanceOperators(bool envelopeStep) {
+#ifdef __SSE2__
+    if (vectorised) {
+        advanceOperatorsSSE2(envelopeStep);
+        return;
+    }
+#endif
+
+    advanceOperatorsScalar(envelopeStep);
+}
+
+/**
+ * Steps every operator's phase and (on envelope cycles) envelope, then works out its final attenuation from the
+ * envelope, total level and tremolo
+ */
+void YM2612::advanceOperatorsScalar(bool envelopeStep) {
+    for (int op = 0; op < YM2612_OPERATORS; op++) {
+        phase[op] = (phase[op] + phaseIncrement[op]) & 0xFFFFF;
+    }
+
+    if (envelopeStep) {
+        for (int op = 0; op < YM2612_OPERATORS; op++) {
+            int level = envelopeAttenuation[op];
+
+            // Attack moves exponentially towards 0, everything else linearly towards YM2612_MAX_ATTENUATION
+            if (attackMask[op]) {
+                level += ((~level) * envelopeIncrement[op]) >> 4;
+            } else {
+                level += envelopeIncrement[op];
+            }
+
+            envelopeAttenuation[op] = (int16_t)std::clamp(level, 0, YM2612_MAX_ATTENUATION);
+        }
+    }
+
+    for (int op = 0; op < YM2612_OPERATORS; op++) {
+        int level = envelopeAttenuation[op] + totalLevel[op] + amAttenuation[op];
+        attenuation[op] = (int16_t)std::min(level, YM2612_MAX_ATTENUATION);
+    }
+}
+
+#ifdef __SSE2__
+/**
+ * The same as advanceOperatorsScalar. Phases are 32 bit so take 6 registers, everything else is 16 bit and takes 3.
+ */
+void YM2612::advanceOperatorsSSE2(bool envelopeStep) {
+    const __m128i phaseMask = _mm_set1_epi32(0xFFFFF);
+
+    for (int op = 0; op < YM2612_OPERATORS; op += 4) {
+        __m128i opPhase = _mm_load_si128((const __m128i *)&phase[op]);
+        __m128i increment = _mm_load_si128((const __m128i *)&phaseIncrement[op]);
+        _mm_store_si128((__m128i *)&phase[op], _mm_and_si128(_mm_add_epi32(opPhase, increment), phaseMask));
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(-1);
+    const __m128i maxAttenuation = _mm_set1_epi16(YM2612_MAX_ATTENUATION);
+
+    for (int op = 0; op < YM2612_OPERATORS; op += 8) {
+        __m128i level = _mm_load_si128((const __m128i *)&envelopeAttenuation[op]);
+
+        if (envelopeStep) {
+            __m128i increment = _mm_load_si128((const __m128i *)&envelopeIncrement[op]);
+            __m128i attack = _mm_load_si128((const __m128i *)&attackMask[op]);
+
+            // ~level * increment fits in 16 bits, the level is at most 10 bits and the increment at most 8
+            __m128i attackStep = _mm_srai_epi16(_mm_mullo_epi16(_mm_xor_si128(level, ones), increment), 4);
+            __m128i step = _mm_or_si128(_mm_and_si128(attack, attackStep), _mm_andnot_si128(attack, increment));
+            level = _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(level, step), zero), maxAttenuation);
+            _mm_store_si128((__m128i *)&envelopeAttenuation[op], level);
+        }
+
+        __m128i total = _mm_add_epi16(level, _mm_load_si128((const __m128i *)&totalLevel[op]));
+        total = _mm_add_epi16(total, _mm_load_si128((const __m128i *)&amAttenuation[op]));
+        _mm_store_si128((__m128i *)&attenuation[op], _mm_min_epi16(total, maxAttenuation));
+    }
+}
+#else
+void YM2612::advanceOperatorsSSE2(bool envelopeStep) {
+    advanceOperatorsScalar(envelopeStep);
+}
+#endif
+
+/**
+ * Runs the channel's operators through its algorithm (S1-S4, -> is modulation, + is mixing):
+ *
+ * 0: S1->S2->S3->S4, 1: (S1+S2)->S3->S4, 2: (S1+(S2->S3))->S4, 3: ((S1->S2)+S3)->S4, 4: (S1->S2)+(S3->S4),
+ * 5: S1->(S2+S3+S4), 6: (S1->S2)+S3+S4, 7: S1+S2+S3+S4
+ *
+ * @return 14 bit signed output
+ */
+int YM2612::getChannelOutput(int channel) {
+    unsigned char feedbackAlgorithm = registers[channel / 3][0xB0 + channel % 3];
+    int feedback = (feedbackAlgorithm >> 3) & 0x07;
+    int op = channel * 4;
+
+    int feedbackModulation = feedback ? (feedbackHistory[channel][0] + feedbackHistory[channel][1]) >> (10 - feedback) : 0;
+    int s1 = getOperatorOutput(op, feedbackModulation);
+    feedbackHistory[channel][0] = feedbackHistory[channel][1];
+    feedbackHistory[channel][1] = (int16_t)s1;
+
+    // Operator outputs are 14 bits and the phase 10, so modulation is the output halved
+    int s2;
+    int s3;
+    int output;
+
+    switch (feedbackAlgorithm & 0x07) {
+        case 0:
+            s2 = getOperatorOutput(op + 1, s1 >> 1);
+            s3 = getOperatorOutput(op + 2, s2 >> 1);
+            output = getOperatorOutput(op + 3, s3 >> 1);
+            break;
+        case 1:
+            s2 = getOperatorOutput(op + 1, 0);
+            s3 = getOperatorOutput(op + 2, (s1 + s2) >> 1);
+            output = getOperatorOutput(op + 3, s3 >> 1);
+            break;
+        case 2:
+            s2 = getOperatorOutput(op + 1, 0);
+            s3 = getOperatorOutput(op + 2, s2 >> 1);
+            output = getOperatorOutput(op + 3, (s1 + s3) >> 1);
+            break;
+        case 3:
+            s2 = getOperatorOutput(op + 1, s1 >> 1);
+            s3 = getOperatorOutput(op + 2, 0);
+            output = getOperatorOutput(op + 3, (s2 + s3) >> 1);
+            break;
+        case 4:
+            s2 = getOperatorOutput(op + 1, s1 >> 1);
+            s3 = getOperatorOutput(op + 2, 0);
+            output = s2 + getOperatorOutput(op + 3, s3 >> 1);
+            break;
+        case 5:
+            output = getOperatorOutput(op + 1, s1 >> 1) + getOperatorOutput(op + 2, s1 >> 1) +
+                     getOperatorOutput(op + 3, s1 >> 1);
+            break;
+        case 6:
+            output = getOperatorOutput(op + 1, s1 >> 1) + getOperatorOutput(op + 2, 0) + getOperatorOutput(op + 3, 0);
+            break;
+        default:
+            output = s1 + getOperatorOutput(op + 1, 0) + getOperatorOutput(op + 2, 0) + getOperatorOutput(op + 3, 0);
+            break;
+    }
+
+    return std::clamp(output, -8192, 8191);
+}
+
+/**
+ * @param modulation - Added to the 10 bit phase
+ * @return 14 bit signed output
+ */
+int YM2612::getOperatorOutput(int op, int modulation) {
+    int operatorPhase = ((phase[op] >> 10) + modulation) & 0x3FF;
+
+    // The table is a quarter of a sine wave, bit 8 mirrors it and bit 9 makes it negative
+    int index = (operatorPhase & 0x100) ? ~operatorPhase & 0xFF : operatorPhase & 0xFF;
+    int level = ym2612LogSinTable[index] + (attenuation[op] << 2);
+
+    if (level >= 13 * 256) {
+        return 0;
+    }
+
+    int output = ym2612PowerTable[level & 0xFF] >> (level >> 8);
+    return (operatorPhase & 0x200) ? -output : output;
+}
+
+const char *YM2612::getImplementationName() {
+#ifdef __SSE2__
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
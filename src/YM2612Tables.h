@@ -0,0 +1,241 @@
+#ifndef MEGANOSTALGIA_YM2612TABLES_H
+#define MEGANOSTALGIA_YM2612TABLES_H
+
+#include <cstdint>
+
+/**
+ * The YM2612's lookup tables, worked out at compile time so they end up in read only data rather than being filled in
+ * by every instance at startup. <cmath> isn't constexpr, so the few functions needed are done with series that are
+ * far more accurate than the rounding the tables need.
+ */
+
+#define YM2612_PI 3.14159265358979323846
+#define YM2612_LN2 0.69314718055994530942
+
+template<typename T, int Size>
+struct YM2612Table {
+    T values[Size];
+
+    constexpr const T &operator[](int index) const {
+        return values[index];
+    }
+};
+
+constexpr int ym2612Round(double value) {
+    return value < 0 ? -(int)(0.5 - value) : (int)(value + 0.5);
+}
+
+/**
+ * @param x - 0 to pi/2
+ */
+constexpr double ym2612Sin(double x) {
+    double term = x;
+    double result = x;
+
+    for (int n = 1; n < 16; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        result += term;
+    }
+
+    return result;
+}
+
+/**
+ * @param x - Greater than 0
+ */
+constexpr double ym2612Log2(double x) {
+    int exponent = 0;
+
+    while (x >= 2) {
+        x /= 2;
+        exponent++;
+    }
+
+    while (x < 1) {
+        x *= 2;
+        exponent--;
+    }
+
+    // ln(x) = 2 * atanh((x - 1) / (x + 1)), which converges quickly for x in [1, 2)
+    double z = (x - 1) / (x + 1);
+    double term = z;
+    double sum = 0;
+
+    for (int n = 1; n < 40; n += 2) {
+        sum += term / n;
+        term *= z * z;
+    }
+
+    return exponent + 2 * sum / YM2612_LN2;
+}
+
+/**
+ * @param x - -1 to 1
+ */
+constexpr double ym2612Exp2(double x) {
+    double y = x * YM2612_LN2;
+    double term = 1;
+    double result = 1;
+
+    for (int n = 1; n < 24; n++) {
+        term *= y / n;
+        result += term;
+    }
+
+    return result;
+}
+
+/**
+ * Quarter of a sine wave as -log2(sin), 4.8 fixed point. Matches the chip's ROM.
+ */
+constexpr YM2612Table<uint16_t, 256> buildYM2612LogSinTable() {
+    YM2612Table<uint16_t, 256> table = {};
+
+    for (int i = 0; i < 256; i++) {
+        table.values[i] = (uint16_t)ym2612Round(-ym2612Log2(ym2612Sin((2 * i + 1) * YM2612_PI / 1024)) * 256);
+    }
+
+    return table;
+}
+
+/**
+ * 2^-x for the fractional part of an attenuation, 13 bits. Matches the chip's ROM with the implied top bit added.
+ */
+constexpr YM2612Table<uint16_t, 256> buildYM2612PowerTable() {
+    YM2612Table<uint16_t, 256> table = {};
+
+    for (int i = 0; i < 256; i++) {
+        table.values[i] = (uint16_t)(ym2612Round(2048 * ym2612Exp2(-(i + 1) / 256.0)) << 2);
+    }
+
+    return table;
+}
+
+/**
+ * Envelope increments for each rate over 8 envelope steps. Rates below 48 only step every 2^(11 - rate / 4) envelope
+ * cycles, faster rates step every cycle by more.
+ */
+constexpr YM2612Table<YM2612Table<unsigned char, 8>, 64> buildYM2612EnvelopeIncrementTable() {
+    constexpr unsigned char patterns[4][8] = {
+            {1, 1, 1, 1, 1, 1, 1, 1},
+            {1, 1, 1, 2, 1, 1, 1, 2},
+            {1, 2, 1, 2, 1, 2, 1, 2},
+            {1, 2, 2, 2, 1, 2, 2, 2}
+    };
+
+    constexpr unsigned char slowPatterns[4][8] = {
+            {0, 1, 0, 1, 0, 1, 0, 1},
+            {0, 1, 0, 1, 1, 1, 0, 1},
+            {0, 1, 1, 1, 0, 1, 1, 1},
+            {0, 1, 1, 1, 1, 1, 1, 1}
+    };
+
+    YM2612Table<YM2612Table<unsigned char, 8>, 64> table = {};
+
+    for (int rate = 0; rate < 64; rate++) {
+        for (int step = 0; step < 8; step++) {
+            unsigned char increment = 0;
+
+            if (rate < 2) {
+                increment = 0;
+            } else if (rate < 48) {
+                increment = slowPatterns[rate & 3][step];
+            } else if (rate < 60) {
+                increment = patterns[rate & 3][step] << ((rate >> 2) - 12);
+            } else {
+                increment = 8;
+            }
+
+            table.values[rate].values[step] = increment;
+        }
+    }
+
+    return table;
+}
+
+inline constexpr YM2612Table<uint16_t, 256> ym2612LogSinTable = buildYM2612LogSinTable();
+inline constexpr YM2612Table<uint16_t, 256> ym2612PowerTable = buildYM2612PowerTable();
+inline constexpr YM2612Table<YM2612Table<unsigned char, 8>, 64> ym2612EnvelopeIncrementTable = buildYM2612EnvelopeIncrementTable();
+
+// Phase increment adjustment for each key code and detune (0-3, bit 2 of the detune makes it negative)
+inline constexpr unsigned char ym2612DetuneTable[32][4] = {
+        {0, 0, 1, 2}, {0, 0, 1, 2}, {0, 0, 1, 2}, {0, 0, 1, 2},
+        {0, 1, 2, 2}, {0, 1, 2, 3}, {0, 1, 2, 3}, {0, 1, 2, 3},
+        {0, 1, 2, 4}, {0, 1, 3, 4}, {0, 1, 3, 4}, {0, 1, 3, 5},
+        {0, 2, 4, 5}, {0, 2, 4, 6}, {0, 2, 4, 6}, {0, 2, 5, 7},
+        {0, 2, 5, 8}, {0, 3, 6, 8}, {0, 3, 6, 9}, {0, 3, 7, 10},
+        {0, 4, 8, 11}, {0, 4, 8, 12}, {0, 4, 9, 13}, {0, 5, 10, 14},
+        {0, 5, 11, 16}, {0, 6, 12, 17}, {0, 6, 13, 19}, {0, 7, 14, 20},
+        {0, 8, 16, 22}, {0, 8, 16, 22}, {0, 8, 16, 22}, {0, 8, 16, 22}
+};
+
+// Vibrato moves the F-number by the sum of its top 7 bits shifted right by these two amounts, for each PMS setting and
+// LFO step within a quarter wave. A shift of 7 adds nothing.
+inline constexpr unsigned char ym2612PMShifts1[8][8] = {
+        {7, 7, 7, 7, 7, 7, 7, 7}, {7, 7, 7, 7, 7, 7, 7, 7}, {7, 7, 7, 7, 7, 7, 1, 1}, {7, 7, 7, 7, 1, 1, 1, 1},
+        {7, 7, 7, 1, 1, 1, 1, 0}, {7, 7, 1, 1, 0, 0, 0, 0}, {7, 7, 1, 1, 0, 0, 0, 0}, {7, 7, 1, 1, 0, 0, 0, 0}
+};
+
+inline constexpr unsigned char ym2612PMShifts2[8][8] = {
+        {7, 7, 7, 7, 7, 7, 7, 7}, {7, 7, 7, 7, 2, 2, 2, 2}, {7, 7, 7, 2, 2, 2, 7, 7}, {7, 7, 2, 2, 7, 7, 2, 2},
+        {7, 7, 2, 7, 7, 7, 2, 7}, {7, 7, 7, 2, 7, 7, 2, 1}, {7, 7, 7, 2, 7, 7, 2, 1}, {7, 7, 7, 2, 7, 7, 2, 1}
+};
+
+/**
+ * Vibrato adjustment to the F-number in half steps, the chip adds it to the F-number with an extra bit below it. PMS 6
+ * and 7 double and quadruple the deepest setting.
+ *
+ * @param pmStep - 0 to 31 (the top 5 bits of the LFO step), a triangle wave that goes up for the first half and down
+ *                 for the second
+ */
+constexpr int ym2612PMAdjustment(uint16_t frequency, int pms, int pmStep) {
+    int quarterStep = (pmStep & 0x08) ? (pmStep & 0x0F) ^ 0x0F : pmStep & 0x0F;
+    int high = (frequency & 0x7FF) >> 4;
+    int adjustment = (high >> ym2612PMShifts1[pms][quarterStep]) + (high >> ym2612PMShifts2[pms][quarterStep]);
+
+    if (pms > 5) {
+        adjustment <<= pms - 5;
+    }
+
+    adjustment >>= 2;
+    return (pmStep & 0x10) ? -adjustment : adjustment;
+}
+
+/**
+ * Whether the deepest vibrato for each PMS setting, at the highest F-number, is close to the depth the datasheet gives.
+ * Those are rounded, so within a cent or 5% (whichever is more) is close enough.
+ */
+constexpr bool ym2612PMDepthsMatchDatasheet() {
+    constexpr double depthCents[8] = {0, 3.4, 6.7, 10, 14, 20, 40, 80};
+
+    for (int pms = 0; pms < 8; pms++) {
+        int peak = 0;
+
+        for (int pmStep = 0; pmStep < 32; pmStep++) {
+            if (ym2612PMAdjustment(0x7FF, pms, pmStep) > peak) {
+                peak = ym2612PMAdjustment(0x7FF, pms, pmStep);
+            }
+        }
+
+        double cents = 1200 * ym2612Log2(1 + peak / 4094.0);
+        double tolerance = depthCents[pms] > 20 ? depthCents[pms] * 0.05 : 1;
+
+        if (cents < depthCents[pms] - tolerance || cents > depthCents[pms] + tolerance) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Spot checks against the ends of the chip's ROMs (the exponent ROM runs from 1018 to 0, without the implied bit)
+static_assert(ym2612LogSinTable[0] == 2137 && ym2612LogSinTable[255] == 0, "Log-sine table doesn't match the chip");
+static_assert(ym2612PowerTable[0] == (1018 | 0x400) << 2 && ym2612PowerTable[255] == 0x400 << 2, "Power table doesn't match the chip");
+
+static_assert(ym2612PMDepthsMatchDatasheet(), "Vibrato depths don't match the datasheet");
+
+// Vibrato only sees the top 7 bits of the F-number and goes down by as much as it goes up
+static_assert(ym2612PMAdjustment(0x7FF, 7, 7) == 190 && ym2612PMAdjustment(0x7FF, 7, 23) == -190 &&
+              ym2612PMAdjustment(0x00F, 7, 7) == 0, "Vibrato doesn't match the chip");
+
+#endif //MEGANOSTALGIA_YM2612TABLES_H
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "Utils.h"
 #include "Emulator.h"
+#include "Benchmark.h"
 
 int main(int argc, char *argv[]) {
 
@@ -9,17 +10,95 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
+    if (argc > 3 && std::string(argv[1]) == "-benchmark" && std::string(argv[2]) == "vgm") {
+        try {
+            Benchmark::runVGM(argv[3], argc > 4 ? argv[4] : "");
+        } catch (GeneralException &e) {
+            std::cout << "An exception has occurred: " << e.what() << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "-benchmark") {
+        uint64_t count = argc > 3 ? std::stoull(argv[3]) : 0;
+
+        if (std::string(argv[2]) == "vdp") {
+            Benchmark::runVDP(count > 0 ? count : VDP_SCREEN_HEIGHT * 1000);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "compositor") {
+            Benchmark::runCompositor(count > 0 ? count : 1000000);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "dma") {
+            Benchmark::runDMA(count > 0 ? count : 10000);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "ym2612") {
+            Benchmark::runYM2612(count > 0 ? count : 53267 * 10);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "psg") {
+            Benchmark::runPSG(count > 0 ? count : 53267 * 10);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "resampler") {
+            Benchmark::runResampler(count > 0 ? count : 60 * 60);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "audiotiming") {
+            Benchmark::runAudioTiming(count > 0 ? count : 60 * 60);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "z80sound") {
+            Benchmark::runZ80Sound(count > 0 ? count : 60 * 10);
+            return 0;
+        }
+
+        if (std::string(argv[2]) == "savestate") {
+            Benchmark::runSaveState(count > 0 ? count : 60 * 10);
+            return 0;
+        }
+    }
 
     // Start the Emulator
     try {
         Emulator *emulator = new Emulator();
 
         std::string romFileName;
+        uint64_t frameLimit = 0;
+        bool renderThreaded = false;
+        std::string audioFileName;
+        bool audioTimingOnly = false;
+        std::string vgmFileName;
 
         if (argc > 1) {
             romFileName = argv[1];
         }
 
+        for (int i = 2; i < argc; i++) {
+            if (std::string(argv[i]) == "-frames" && i + 1 < argc) {
+                frameLimit = std::stoull(argv[++i]);
+            } else if (std::string(argv[i]) == "-threaded-render") {
+                renderThreaded = true;
+            } else if (std::string(argv[i]) == "-audio-out" && i + 1 < argc) {
+                audioFileName = argv[++i];
+            } else if (std::string(argv[i]) == "-vgm-out" && i + 1 < argc) {
+                vgmFileName = argv[++i];
+            } else if (std::string(argv[i]) == "-timing-only-audio") {
+                audioTimingOnly = true;
+            }
+        }
+
         if (romFileName.empty()) {
             std::cout<<"Usage:"<<
                      std::endl<<
@@ -30,12 +109,61 @@ int main(int argc, char *argv[]) {
                      "Other parameters:"<<
                      std::endl<<
                      std::endl<<
-                     "Display version information and exit: -v"<<std::endl;
+                     "Display version information and exit: -v"<<
+                     std::endl<<
+                     "Run a fixed number of frames and display statistics: ./MegaNostalgia \"(path to ROM file)\" -frames (number of frames)"<<
+                     std::endl<<
+                     "Draw the screen on a separate thread: -threaded-render"<<
+                     std::endl<<
+                     "Record every sound chip write to a VGM file, compressed if it ends in .vgz: -vgm-out (path to file)"<<
+                     std::endl<<
+                     "Skip sound synthesis, keeping only the YM2612 timers and status running: -timing-only-audio"<<
+                     std::endl<<
+                     "Write the audio to a file, WAV if it ends in .wav and raw 16 bit stereo samples otherwise: -audio-out (path to file)"<<
+                     std::endl<<
+                     "Measure VDP rendering speed: ./MegaNostalgia -benchmark vdp (number of lines)"<<
+                     std::endl<<
+                     "Compare each vectorised line compositor against the scalar one: ./MegaNostalgia -benchmark compositor (number of lines)"<<
+                     std::endl<<
+                     "Measure 68k to VRAM DMA speed and check a full length transfer: ./MegaNostalgia -benchmark dma (number of transfers)"<<
+                     std::endl<<
+                     "Measure YM2612 speed and compare against the scalar reference: ./MegaNostalgia -benchmark ym2612 (number of samples)"<<
+                     std::endl<<
+                     "Measure PSG speed at different pitches: ./MegaNostalgia -benchmark psg (number of samples)"<<
+                     std::endl<<
+                     "Compare the vectorised and scalar audio resamplers: ./MegaNostalgia -benchmark resampler (number of frames)"<<
+                     std::endl<<
+                     "Compare full sound synthesis against timing only mode: ./MegaNostalgia -benchmark audiotiming (number of frames)"<<
+                     std::endl<<
+                     "Run a Z80 sound driver and check its busy flag and timer timing: ./MegaNostalgia -benchmark z80sound (number of frames)"<<
+                     std::endl<<
+                     "Check that a restored save state runs the same as the original, and time saving and restoring: ./MegaNostalgia -benchmark savestate (number of frames)"<<
+                     std::endl<<
+                     "Play a VGM file through the sound chips alone: ./MegaNostalgia -benchmark vgm (path to VGM file) (optional path to output WAV)"<<std::endl;
 
             return 0;
         }
 
         emulator->init(romFileName);
+        emulator->setRenderThreaded(renderThreaded);
+        emulator->setAudioTimingOnly(audioTimingOnly);
+
+        if (!audioFileName.empty()) {
+            emulator->startAudioFile(audioFileName);
+        }
+
+        if (!vgmFileName.empty()) {
+            emulator->startVGMLog(vgmFileName);
+        }
+
+        if (frameLimit > 0) {
+            emulator->runFrames(frameLimit);
+            emulator->stopAudioFile();
+            emulator->stopVGMLog();
+            emulator->printStats();
+            return 0;
+        }
+
         emulator->run();
     } catch (GeneralException &e) {
         std::cout<<"An exception has occurred: "<<e.what()<<std::endl;